@@ -26,17 +26,25 @@ fi
 echo "Compiling p1x3..."
 gcc -o "$BIN_DIR/p1x3" \
     "$SRC_DIR/cclass.c" \
+    "$SRC_DIR/deps.c" \
     "$SRC_DIR/emit.c" \
     "$SRC_DIR/expr.c" \
+    "$SRC_DIR/frame.c" \
+    "$SRC_DIR/intern.c" \
     "$SRC_DIR/lex.c" \
     "$SRC_DIR/main.c" \
-    "$SRC_DIR/memchk.c" \
+    "$SRC_DIR/arena.c" \
     "$SRC_DIR/op.c" \
+    "$SRC_DIR/out.c" \
+    "$SRC_DIR/pch.c" \
     "$SRC_DIR/program.c" \
+    "$SRC_DIR/regs.c" \
+    "$SRC_DIR/server.c" \
+    "$SRC_DIR/stats.c" \
     "$SRC_DIR/stmt.c" \
     "$SRC_DIR/sym.c" \
     "$SRC_DIR/type.c" \
-    -O2 -w
+    -O2 -w -pthread
 
 if [ -f "$BIN_DIR/p1x3" ]; then
     echo "Success: p1x3 built"
@@ -46,6 +54,18 @@ else
     exit 1
 fi
 
+# Build the zc3 driver
+echo "Compiling zc3..."
+gcc -o "$BIN_DIR/zc3" source/zc/zc.c source/zc/cache.c source/zc/sha256.c -O2 -w
+
+if [ -f "$BIN_DIR/zc3" ]; then
+    echo "Success: zc3 built"
+    ls -la "$BIN_DIR/zc3"
+else
+    echo "Error: Build failed"
+    exit 1
+fi
+
 echo ""
 echo "========================================"
 echo "Build complete!"
@@ -0,0 +1,172 @@
+/*
+ * arena.c - region allocation for p1x3's symbol, expression and argument nodes
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Region allocation for sym_t, expr_t and args_t nodes.
+ * The original recycled nodes through free lists and used inData() to
+ * avoid freeing the static constants. Nodes are now carved out of
+ * large blocks and released in bulk: tuArena lives for the whole
+ * translation unit, bodyArena is reset when a function body's scope is
+ * exited, see enterScope / exitScope.
+ */
+#define ARENABLOCK 0x10000
+
+typedef struct _block {
+    struct _block *next;
+    size_t size;
+    size_t used; /* bytes handed out, set when the block is retired */
+} block_t;
+
+TLS arena_t tuArena;
+TLS arena_t bodyArena;
+TLS arena_t *curArena; /* set by resetArenas */
+bool a_opt; /* -A report arena usage */
+
+static TLS size_t peakTotal;    /* peak of tuArena + bodyArena in use */
+static TLS size_t peakReserved; /* peak of the blocks obtained from malloc */
+
+/**************************************************
+ * allocate a new block of at least size bytes
+ **************************************************/
+static void newBlock(register arena_t *ap, size_t size) {
+    block_t *bp;
+
+    if (size < ARENABLOCK - sizeof(block_t))
+        size = ARENABLOCK - sizeof(block_t);
+    if (!(bp = malloc(sizeof(block_t) + size)))
+        fatalErr("Out of memory");
+    if (ap->blocks)
+        ap->blocks->used = ap->cur - (char *)(ap->blocks + 1);
+    bp->size   = size;
+    bp->next   = ap->blocks;
+    ap->blocks = bp;
+    ap->cur    = (char *)(bp + 1);
+    ap->end    = ap->cur + size;
+    ap->reserved += sizeof(block_t) + size;
+    if (tuArena.reserved + bodyArena.reserved > peakReserved)
+        peakReserved = tuArena.reserved + bodyArena.reserved;
+}
+
+/**************************************************
+ * return size zeroed bytes from the given arena
+ **************************************************/
+void *arenaAllocIn(register arena_t *ap, size_t size) {
+    char *p;
+
+    size = (size + ARENAALIGN - 1) & ~(ARENAALIGN - 1);
+    if ((size_t)(ap->end - ap->cur) < size)
+        newBlock(ap, size);
+    p = ap->cur;
+    ap->cur += size;
+    ap->used += size;
+    if (ap->used > ap->peak)
+        ap->peak = ap->used;
+    if (tuArena.used + bodyArena.used > peakTotal)
+        peakTotal = tuArena.used + bodyArena.used;
+    blkclr(p, size);
+    return p;
+}
+
+/**************************************************
+ * return size zeroed bytes from the current arena
+ **************************************************/
+void *arenaAlloc(size_t size) {
+    return arenaAllocIn(curArena, size);
+}
+
+/**************************************************
+ * true if p was allocated from the arena
+ **************************************************/
+bool arenaOwns(arena_t *ap, void *p) {
+    register block_t *bp;
+
+    for (bp = ap->blocks; bp; bp = bp->next)
+        if ((char *)(bp + 1) <= (char *)p && (char *)p < (char *)(bp + 1) + bp->size)
+            return true;
+    return false;
+}
+
+/**************************************************
+ * call fn for the used part of each block, oldest
+ * first, so the allocations are seen in order
+ **************************************************/
+static void walkBlocks(register arena_t *ap, block_t *bp, void (*fn)(char *p, size_t len)) {
+    if (!bp)
+        return;
+    walkBlocks(ap, bp->next, fn);
+    fn((char *)(bp + 1), bp == ap->blocks ? (size_t)(ap->cur - (char *)(bp + 1)) : bp->used);
+}
+
+void arenaWalk(arena_t *ap, void (*fn)(char *p, size_t len)) {
+    walkBlocks(ap, ap->blocks, fn);
+}
+
+/**************************************************
+ * release everything in the arena, the first block
+ * allocated is kept for reuse
+ **************************************************/
+void arenaReset(register arena_t *ap) {
+    block_t *bp;
+
+    while ((bp = ap->blocks) && bp->next) {
+        ap->blocks = bp->next;
+        ap->reserved -= sizeof(block_t) + bp->size;
+        free(bp);
+    }
+    if (bp) {
+        ap->cur = (char *)(bp + 1);
+        ap->end = ap->cur + bp->size;
+    }
+    ap->used = 0;
+}
+
+/**************************************************
+ * empty both arenas and the usage figures before
+ * the next translation unit
+ **************************************************/
+void resetArenas(void) {
+    arenaReset(&tuArena);
+    arenaReset(&bodyArena);
+    curArena       = &tuArena;
+    tuArena.peak   = 0;
+    bodyArena.peak = 0;
+    peakTotal      = 0;
+    peakReserved   = tuArena.reserved + bodyArena.reserved;
+}
+
+/**************************************************
+ * report peak arena usage for -A
+ **************************************************/
+void prArenaStats(void) {
+    fprintf(errFp, "arena: peak %lu bytes (unit %lu, function body %lu), %lu bytes reserved\n",
+            (unsigned long)peakTotal, (unsigned long)tuArena.peak, (unsigned long)bodyArena.peak,
+            (unsigned long)peakReserved);
+}
+
+/**************************************************
+ * the same figures for -stats
+ **************************************************/
+void arenaStats(void) {
+    statsGroup("arena");
+    statsNum("peak", (unsigned long)peakTotal);
+    statsNum("unit", (unsigned long)tuArena.peak);
+    statsNum("body", (unsigned long)bodyArena.peak);
+    statsNum("reserved", (unsigned long)peakReserved);
+}
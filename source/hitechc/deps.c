@@ -0,0 +1,134 @@
+/*
+ * deps.c - make dependency rules written by p1x3 -M
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * -Mfile, the files a unit was made from as a make rule.
+ * The names come from the line markers cpp leaves, as the lexer meets
+ * them or, for the part of the input a precompiled header stood in for,
+ * from a scan of that text. The rule's target is the file's name with
+ * .obj for its suffix, which is where zc3 puts the object, and each
+ * header also gets an empty rule so make carries on if it is removed.
+ */
+char *depFile;      /* -M */
+TLS bool wantDeps;  /* collect the names for this unit */
+static TLS char **deps; /* interned, in the order first seen */
+static TLS int depCnt;
+static TLS int depMax;
+
+/**************************************************
+ * start the list for a new unit
+ **************************************************/
+void depReset(void) {
+    depCnt = 0;
+}
+
+/**************************************************
+ * add the interned name, once
+ **************************************************/
+void depAdd(char *name) {
+    register int i;
+
+    if (!*name || strcmp(name, "(stdin)") == 0)
+        return;
+    for (i = depCnt; --i >= 0;)
+        if (deps[i] == name)
+            return;
+    if (depCnt == depMax && !(deps = realloc(deps, (depMax += 32) * sizeof(deps[0]))))
+        fatalErr("Out of memory");
+    deps[depCnt++] = name;
+}
+
+/**************************************************
+ * add the files named by the line markers between
+ * s and end
+ **************************************************/
+void depScan(register char *s, char *end) {
+    char *name;
+    char *nl;
+    size_t len;
+
+    for (; s < end; s = nl + 1) {
+        if (!(nl = memchr(s, '\n', end - s)))
+            nl = end;
+        if ((name = lineMarker(s, nl, &len))) {
+            if (len == 0)
+                depAdd(intern(srcFileArg, (int16_t)strlen(srcFileArg)));
+            else
+                depAdd(intern(name, (int16_t)(len < sizeof(srcFile) ? len : sizeof(srcFile) - 1)));
+        }
+    }
+}
+
+/**************************************************
+ * the names collected, one per line
+ **************************************************/
+void depList(FILE *fp) {
+    int i;
+
+    for (i = 0; i < depCnt; i++)
+        fprintf(fp, "%s\n", deps[i]);
+}
+
+/* a name as make wants it */
+static void depName(register char *s, FILE *fp) {
+    for (; *s; s++) {
+        if (*s == ' ' || *s == '\t' || *s == '#')
+            fputc('\\', fp);
+        else if (*s == '$')
+            fputc('$', fp);
+        fputc(*s, fp);
+    }
+}
+
+/**************************************************
+ * write the rule to file
+ **************************************************/
+void depWrite(char *file) {
+    register char *s;
+    char *target;
+    FILE *fp;
+    int i;
+
+    target = xalloc(strlen(file) + 5);
+    strcpy(target, file);
+    if ((s = strrchr(target, '.')) && !strchr(s, '/'))
+        *s = '\0';
+    strcat(target, ".obj");
+    if (!(fp = fopen(file, "w"))) {
+        prError("can't create %s", file);
+        free(target);
+        return;
+    }
+    depName(target, fp);
+    fputc(':', fp);
+    for (i = 0; i < depCnt; i++) {
+        fputs(" \\\n  ", fp);
+        depName(deps[i], fp);
+    }
+    fputc('\n', fp);
+    for (i = 1; i < depCnt; i++) {
+        fputc('\n', fp);
+        depName(deps[i], fp);
+        fputs(":\n", fp);
+    }
+    if (fclose(fp) == -1)
+        prError("close error on %s (disk space?)", file);
+    free(target);
+}
@@ -31,9 +31,8 @@
  */
 #include "p1.h"
 
-int16_t word_9caf; /*9caf */
-char ca9CB1[64];   /* 9cb1 */
-void sub_013d(register FILE *p);
+TLS int32_t word_9caf; /*9caf */
+TLS int16_t lastSrcId; /* 9cb1 was ca9CB1[64] */
 void sub_01c1(register sym_t *p);
 void sub_0470(expr_t *p);
 void sub_05f1(register expr_t *st);
@@ -41,16 +40,19 @@ void sub_05f1(register expr_t *st);
 /**************************************************
  * 1: 013D PMO +++
  **************************************************/
-void sub_013d(register FILE *p) {
-
-    if (word_9caf != lineNo || strcmp(ca9CB1, srcFile) != 0) {
-        fprintf(p, "\"%d", lineNo);
-        if (strcmp(srcFile, ca9CB1) != 0)
-            fprintf(p, " %s", srcFile);
-        fputc('\n', p);
+void sub_013d(register out_t *p) {
+
+    if (word_9caf != lineNo || lastSrcId != srcId) {
+        outCh(p, '"');
+        outNum(p, lineNo);
+        if (lastSrcId != srcId) {
+            outCh(p, ' ');
+            outStr(p, srcFile);
+        }
+        outCh(p, '\n');
     }
     word_9caf = lineNo;
-    strcpy(ca9CB1, srcFile);
+    lastSrcId = srcId;
     if (s_opt != 0)
         emitSrcInfo();
 }
@@ -63,7 +65,7 @@ void sub_01c1(register sym_t *p) {
     if (p->a_c7 == ENODE)
         sub_0470(p->a_expr);
     else
-        putchar('1');
+        outCh(&irOut, '1');
 }
 
 /**************************************************
@@ -82,20 +84,23 @@ void sub_01ec(register sym_t *p) {
  * a ld a,(ix+6)
  **************************************************/
 void prFuncBrace(uint8_t tok) {
+    dataPsect = false;
     if (tok == T_RBRACE)
-        putchar('}');
+        outCh(&irOut, '}');
     else if (tok == T_LBRACE)
-        putchar('{');
-    putchar('\n');
+        outCh(&irOut, '{');
+    outCh(&irOut, '\n');
 }
 
 /**************************************************
  * 5: 0258 PMO +++
  **************************************************/
-void emitLabelDef(int16_t p) {
+void emitLabelDef(int32_t p) {
 
-    sub_013d(stdout);
-    printf("[e :U %d ]\n", p); /* EXPR :U */
+    sub_013d(&irOut);
+    outStr(&irOut, "[e :U "); /* EXPR :U */
+    outNum(&irOut, p);
+    outStr(&irOut, " ]\n");
 }
 
 /**************************************************
@@ -104,34 +109,210 @@ void emitLabelDef(int16_t p) {
 void sub_0273(register sym_t *st) {
 
     if (st) {
-        sub_013d(stdout);
-        printf("[e :U "); /* EXPR :U */
-        sub_573b(st, stdout);
-        printf(" ]\n");
+        sub_013d(&irOut);
+        outStr(&irOut, "[e :U "); /* EXPR :U */
+        sub_573b(st, &irOut);
+        outStr(&irOut, " ]\n");
     }
 }
 
+typedef struct {
+    long val;  /* the case value in the type of the switch */
+    s4_t *cs;
+} caseRef_t;
+
+typedef struct {
+    int32_t first; /* index of the first case */
+    int32_t cnt;
+    bool table; /* dense, the gaps go to the default label */
+} caseSeg_t;
+
+/**************************************************
+ * qsort order of caseRef_t by value
+ **************************************************/
+static int cmpCase(const void *p1, const void *p2) {
+    long a = ((caseRef_t *)p1)->val;
+    long b = ((caseRef_t *)p2)->val;
+
+    return a < b ? -1 : a > b;
+}
+
+/**************************************************
+ * the cases of p1 sorted by value, NULL unless they
+ * are distinct integer constants
+ **************************************************/
+static caseRef_t *sortCases(register case_t *p1) {
+    caseRef_t *cases;
+    expr_t *pe;
+    int32_t i;
+
+    if (!p1->switchExpr || !sub_5b08(&p1->switchExpr->attr) ||
+        p1->switchExpr->attr.dataType < DT_CHAR || p1->caseCnt < 2)
+        return NULL;
+    cases = arenaAlloc(p1->caseCnt * sizeof(caseRef_t));
+    for (i = 0; i < p1->caseCnt; i++) {
+        if (!(pe = p1->caseOptions[i].caseVal) || pe->tType != T_ICONST || isStaticExpr(pe))
+            return NULL;
+        cases[i].val = normConst(pe->t_l, p1->switchExpr->attr.dataType);
+        cases[i].cs  = &p1->caseOptions[i];
+    }
+    qsort(cases, p1->caseCnt, sizeof(caseRef_t), cmpCase);
+    for (i = 1; i < p1->caseCnt; i++)
+        if (cases[i].val == cases[i - 1].val)
+            return NULL;
+    return cases;
+}
+
+/**************************************************
+ * split the cnt sorted cases into runs that are at
+ * least half full and long enough for cgen3 to
+ * index a table, and runs of up to CASELEAF others
+ * returns the number of runs in seg
+ **************************************************/
+static int32_t splitCases(register caseRef_t *cases, int32_t cnt, caseSeg_t *seg) {
+    int32_t i;
+    int32_t j;
+    int32_t k;
+    int32_t n;
+
+    for (n = i = 0; i < cnt; i = j) {
+        for (j = k = i; k < cnt && cases[k].val - cases[i].val < CASECHUNK; k++)
+            if (cases[k].val - cases[i].val < 2 * (k - i + 1))
+                j = k;
+        if (++j - i >= CASETABLE) {
+            seg[n].first   = i;
+            seg[n].cnt     = j - i;
+            seg[n++].table = true;
+        } else {
+            j = i + 1;
+            if (n && !seg[n - 1].table && seg[n - 1].cnt < CASELEAF)
+                seg[n - 1].cnt++;
+            else {
+                seg[n].first   = i;
+                seg[n].cnt     = 1;
+                seg[n++].table = false;
+            }
+        }
+    }
+    return n;
+}
+
+/**************************************************
+ * emit one [\ record for a run of cases. The gaps
+ * of a table are filled with the default label so
+ * cgen3 sees a full range
+ **************************************************/
+static void emitCaseRec(case_t *p1, register caseRef_t *cases, caseSeg_t *seg) {
+    caseRef_t *end;
+    expr_t *pe;
+    long val;
+
+    sub_013d(&irOut);
+    outStr(&irOut, "[\\ "); /* CASE */
+    sub_0470(p1->switchExpr);
+    outCh(&irOut, '\n');
+    end = cases + seg->first + seg->cnt;
+    for (cases += seg->first, val = cases->val; cases != end; cases++, val++) {
+        for (; seg->table && val != cases->val; val++) {
+            pe       = sub_1b4b(val, DT_INT);
+            pe->attr = cases->cs->caseVal->attr;
+            outCh(&irOut, '\t');
+            sub_0470(pe);
+            outCh(&irOut, ' ');
+            outNum(&irOut, p1->defLabel);
+            outCh(&irOut, '\n');
+        }
+        outCh(&irOut, '\t');
+        sub_0470(cases->cs->caseVal);
+        outCh(&irOut, ' ');
+        outNum(&irOut, cases->cs->caseLabel);
+        outCh(&irOut, '\n');
+    }
+    outStr(&irOut, "\t.. ");
+    outNum(&irOut, p1->defLabel);
+    outStr(&irOut, "\n]\n");
+}
+
+/**************************************************
+ * emit the runs seg[0..cnt-1] as a binary search
+ * on the first value of the middle run, ending in
+ * one [\ record per run
+ **************************************************/
+static void emitCaseTree(case_t *p1, caseRef_t *cases, register caseSeg_t *seg, int32_t cnt) {
+    int32_t label;
+    int32_t mid;
+    expr_t *pe;
+
+    if (cnt == 1) {
+        emitCaseRec(p1, cases, seg);
+        return;
+    }
+    mid      = cnt / 2;
+    label    = newTmpLabel();
+    pe       = sub_1b4b(cases[seg[mid].first].val, DT_INT);
+    pe->attr = cases[seg[mid].first].cs->caseVal->attr;
+    sub_4d15(label, sub_1441(T_GE, sub_21c7(p1->switchExpr), pe), 1);
+    emitCaseTree(p1, cases, seg, mid);
+    emitLabelDef(label);
+    emitCaseTree(p1, cases, seg + mid, cnt - mid);
+}
+
 /**************************************************
  * 7: 02A6 PMO +++
+ * a switch whose cases are constants is split in
+ * dense runs, given to cgen3 as full ranges it
+ * indexes a table with, and sparse runs. If there
+ * is more than one run and the switch expression
+ * can be evaluated again, the runs are reached by
+ * a binary search
  **************************************************/
 void sub_02a6(case_t *p1) {
-    int16_t caseCnt;
+    int32_t caseCnt;
+    int32_t n;
+    int32_t next;
     register s4_t *st;
+    caseRef_t *cases;
+    caseSeg_t *seg;
 
     if (p1) {
-        sub_013d(stdout);
-        printf("[\\ "); /* CASE */
-        sub_0470(p1->switchExpr);
-        putchar('\n');
+        if ((cases = sortCases(p1))) {
+            seg = arenaAlloc(p1->caseCnt * sizeof(caseSeg_t));
+            n   = splitCases(cases, p1->caseCnt, seg);
+            if (n == 1 && seg->table) {
+                emitCaseRec(p1, cases, seg);
+                return;
+            }
+            if (n > 1 && isPureExpr(p1->switchExpr)) {
+                emitCaseTree(p1, cases, seg, n);
+                return;
+            }
+        }
         caseCnt = p1->caseCnt;
-        for (st = p1->caseOptions; caseCnt--; st++) {
-            putchar('\t');
-            sub_0470(st->caseVal);
-            printf(" %d\n", st->caseLabel);
+        st      = p1->caseOptions;
+        for (;;) {
+            /* cgen3 takes CASECHUNK cases a record, the rest follow in
+             * further records reached through the default label. The
+             * switch expression has been checked to be side effect free */
+            caseCnt -= n = caseCnt > CASECHUNK ? CASECHUNK : caseCnt;
+            next = caseCnt ? newTmpLabel() : p1->defLabel;
+            sub_013d(&irOut);
+            outStr(&irOut, "[\\ "); /* CASE */
+            sub_0470(p1->switchExpr);
+            outCh(&irOut, '\n');
+            for (; n--; st++) {
+                outCh(&irOut, '\t');
+                sub_0470(st->caseVal);
+                outCh(&irOut, ' ');
+                outNum(&irOut, st->caseLabel);
+                outCh(&irOut, '\n');
+            }
+            outStr(&irOut, "\t.. ");
+            outNum(&irOut, next);
+            outStr(&irOut, "\n]\n");
+            if (!caseCnt)
+                break;
+            emitLabelDef(next);
         }
-        putchar('\t');
-        printf(".. %d\n", p1->defLabel);
-        printf("]\n");
     }
 }
 
@@ -145,22 +326,23 @@ void sub_0353(sym_t *p, char c) {
         for (st = p->nMemberList; st != p; st = st->nMemberList)
             sub_01ec(st);
 
-        sub_013d(stdout);
-        putchar('[');
+        sub_013d(&irOut);
         if (c == D_STRUCT)
-            putchar('s'); /* STRUCT */
+            outStr(&irOut, "[s S"); /* STRUCT */
         else
-            putchar('u'); /* UNION */
-        printf(" S%d", p->a_labelId);
+            outStr(&irOut, "[u S"); /* UNION */
+        outNum(&irOut, p->a_labelId);
         for (st = p->nMemberList; st != p; st = st->nMemberList) {
-            if ((st->m18 & 0x400))
-                printf(" :%d", st->m16);
-            putchar(' ');
+            if ((st->m18 & 0x400)) {
+                outStr(&irOut, " :");
+                outNum(&irOut, st->m16);
+            }
+            outCh(&irOut, ' ');
             sub_7454(&st->attr);
-            putchar(' ');
+            outCh(&irOut, ' ');
             sub_01c1(st);
         }
-        printf(" ]\n");
+        outStr(&irOut, " ]\n");
     }
 }
 
@@ -169,23 +351,28 @@ void sub_0353(sym_t *p, char c) {
  **************************************************/
 void sub_042d(register expr_t *p) {
 
-    sub_013d(stdout);
-    printf("[e "); /* EXPR */
+    sub_013d(&irOut);
+    outStr(&irOut, "[e "); /* EXPR */
     while (p && p->tType == T_124)
         p = p->t_next;
     sub_0470(p);
-    printf(" ]\n");
+    outStr(&irOut, " ]\n");
 }
 
 /**************************************************
  * 10: 0470 PMO +++
  **************************************************/
 void sub_0470(expr_t *p) {
+    int phase = PH_OTHER;
 
+    if (statsOpt)
+        phase = statsPhase(PH_EMIT);
     if (p)
         sub_05f1(p);
     else
-        putchar('1');
+        outCh(&irOut, '1');
+    if (statsOpt)
+        statsPhase(phase);
 }
 
 /**************************************************
@@ -195,25 +382,30 @@ void sub_0493(register sym_t *st) {
     char c;
 
     if (st) {
-        sub_013d(stdout);
+        sub_013d(&irOut);
         sub_01ec(st);
         st->m18 |= 0x100;
-        printf("[v "); /* VAR */
-        sub_573b(st, stdout);
-        putchar(' ');
+        if (st->frameOff) /* in __frame, cgen is not told of it */
+            return;
+        outStr(&irOut, "[v "); /* VAR */
+        sub_573b(st, &irOut);
+        outCh(&irOut, ' ');
         sub_7454(&st->attr);
-        putchar(' ');
+        outCh(&irOut, ' ');
         if (st->m18 & 1)
             sub_01c1(st);
         else
-            putchar('0');
+            outCh(&irOut, '0');
         if (st->m20 == D_6)
             c = (st->m18 & 0x200) ? 'r' : 'p';
         else
             c = *keywords[(unsigned)st->m20 - 19];
         if (st->m18 & 4)
             c += 0xE0;
-        printf(" %c ]\n", c);
+        outCh(&irOut, ' ');
+        outCh(&irOut, c);
+        regVar(st);
+        outStr(&irOut, " ]\n");
     }
 }
 
@@ -223,13 +415,15 @@ void sub_0493(register sym_t *st) {
 void sub_053f(register expr_t *st, char *pc) {
     int16_t var2;
 
-    sub_013d(tmpFp);
-    fprintf(tmpFp, "[a %d", st->t_i0);
+    sub_013d(&tmpOut);
+    outStr(&tmpOut, "[a ");
+    outNum(&tmpOut, st->t_i0);
     var2 = st->t_i2;
     do {
-        fprintf(tmpFp, " %d", *pc++);
+        outCh(&tmpOut, ' ');
+        outNum(&tmpOut, *pc++);
     } while (var2--);
-    fprintf(tmpFp, " ]\n");
+    outStr(&tmpOut, " ]\n");
 }
 
 /**************************************************
@@ -237,9 +431,9 @@ void sub_053f(register expr_t *st, char *pc) {
  **************************************************/
 void sub_05b5(expr_t *p1) {
 
-    sub_013d(stdout);
+    sub_013d(&irOut);
     sub_0470(p1);
-    putchar('\n');
+    outCh(&irOut, '\n');
 }
 
 /**************************************************
@@ -247,9 +441,9 @@ void sub_05b5(expr_t *p1) {
  **************************************************/
 void sub_05d3(expr_t *p1) {
 
-    sub_013d(stdout);
+    sub_013d(&irOut);
     sub_0470(p1);
-    putchar('\n');
+    outCh(&irOut, '\n');
 }
 
 /**************************************************
@@ -268,52 +462,59 @@ void sub_05f1(register expr_t *st) {
         case T_ID:
             var4 = st->t_pSym;
             if (var4->m20 == D_CONST) {
-                printf(". `");
-                sub_573b(var4->nMemberList, stdout);
-                printf(" %d", var4->m14);
+                outStr(&irOut, ". `");
+                sub_573b(var4->nMemberList, &irOut);
+                outCh(&irOut, ' ');
+                outNum(&irOut, var4->m14);
             } else
-                sub_573b(var4, stdout);
+                sub_573b(var4, &irOut);
             break;
         case T_ICONST:
             if (sub_5a76(&st->attr, DT_VOID) != 0) {
-                printf("%ld", st->t_ul);
+                outNum(&irOut, (long)st->t_ul);
                 break;
-            } else
-                printf("-> %ld ", st->t_ul);
+            } else {
+                outStr(&irOut, "-> ");
+                outNum(&irOut, (long)st->t_ul);
+                outCh(&irOut, ' ');
+            }
         /* FALLTHRU */
         case S_TYPE:
             sub_7454(&st->attr);
             break;
         case T_FCONST:
-            printf(".%s", st->t_s);
+            outCh(&irOut, '.');
+            outStr(&irOut, st->t_s);
             break;
         case T_SCONST:
-            printf(":s %d", st->t_i0);
+            outStr(&irOut, ":s ");
+            outNum(&irOut, st->t_i0);
             break;
         case T_126:
-            printf("%d", st->t_i0); /* m12: */
+            outNum(&irOut, st->t_i0); /* m12: */
             break;
         }
     } else {
         if (st->tType == T_SIZEOF)
-            printf("-> ");
+            outStr(&irOut, "-> ");
         if (st->tType == T_SIZEOF && (var6 = st->t_next)->tType == T_ID &&
             !(var6->t_pSym->m18 & 1)) {
-            printf("* # ");
+            outStr(&irOut, "* # ");
             sub_7454(&var6->attr);
-            putchar(' ');
+            outCh(&irOut, ' ');
             sub_01c1(var6->t_pSym);
-            putchar(' ');
+            outCh(&irOut, ' ');
             sub_7454(&st->attr);
         } else {
-            printf("%.3s ", var2->s0);
+            outWrite(&irOut, var2->s0, var2->s0[2] ? 3 : strlen(var2->s0));
+            outCh(&irOut, ' ');
             if (st->tType != T_120) {
                 sub_05f1(st->t_next);
                 if (var2->uc4 & 2) {
-                    putchar(' ');
+                    outCh(&irOut, ' ');
                     sub_05f1(st->t_alt);
                 } else if (st->tType == T_SIZEOF) {
-                    putchar(' ');
+                    outCh(&irOut, ' ');
                     sub_7454(&st->attr);
                 }
             }
@@ -324,8 +525,11 @@ void sub_05f1(register expr_t *st) {
 /**************************************************
  * 16: 07E3 PMO +++
  * optimiser removes call csv & jp cret
+ * also forgets the last line record so each unit
+ * in -batch starts with the file name
  **************************************************/
 void sub_07e3(void) {
-    s13SP       = &s13Stk[20];
-    s13FreeList = 0;
+    s13SP     = s13End;
+    word_9caf = 0;
+    lastSrcId = 0;
 }
@@ -31,23 +31,26 @@
  */
 #include "p1.h"
 
-s2_t *p2List      = &s2_9cf3[20]; /* 8bc7 */
-int16_t strId     = 0;            /* 8bd7 */
-uint8_t byte_8f85 = 0;            /* 8f85 */
-bool byte_8f86 = false;        /* 8f86 */
-uint8_t byte_968b;                /* 968b */
-int16_t word_968c;                /* 968c */
-int16_t tmpLabelId;               /* 968e */
-
-expr_t **s13SP;   /* 9cf1 */
-s2_t s2_9cf3[20]; /* 9cf3 */
-char pad9d00[27];
-expr_t s13_9d1b; /* 9d1b */
-expr_t s13_9d28; /* 9d28 */
-
-expr_t *s13FreeList; /* 9d35 */
-uint8_t byte_9d37;   /* 9d37 */
-expr_t *s13Stk[20];  /* 9d38 */
+TLS s2_t *p2List;                     /* 8bc7 set by resetExpr */
+TLS int32_t strId     = 0;            /* 8bd7 */
+TLS uint8_t byte_8f85 = 0;            /* 8f85 */
+TLS bool byte_8f86 = false;           /* 8f86 */
+TLS uint8_t byte_968b;                /* 968b */
+TLS int16_t word_968c;                /* 968c */
+TLS int32_t tmpLabelId;               /* 968e */
+
+#define EXPRSTKINIT 20 /* initial depth of the parser stacks, they double */
+
+TLS expr_t **s13SP;  /* 9cf1 */
+TLS s2_t *s2_9cf3;   /* 9cf3 was [20] */
+TLS s2_t *s2End;     /* top of s2_9cf3, followed by one zeroed guard entry */
+TLS char pad9d00[27];
+TLS expr_t s13_9d1b; /* 9d1b */
+TLS expr_t s13_9d28; /* 9d28 */
+
+TLS uint8_t byte_9d37; /* 9d37 */
+TLS expr_t **s13Stk;   /* 9d38 was [20] */
+TLS expr_t **s13End;   /* top of s13Stk */
 
 /* expr.c */
 expr_t *sub_0817(register s8_t *st);
@@ -71,7 +74,6 @@ expr_t *s13Alloc(uint8_t tok);
 expr_t *sub_225a(uint8_t p1, register expr_t *st, expr_t *p3);
 expr_t *sub_23b4(uint8_t tok, register expr_t *st, expr_t *p3);
 expr_t *allocSConst(void);
-void complexErr(void);
 expr_t *popExpr(void);
 void sub_2529(uint8_t p1);
 uint8_t sub_255d(void);
@@ -245,8 +247,8 @@ bool sub_0b93(register expr_t *st) {
 expr_t *sub_0bfc(void) {
     s8_t var8;
     expr_t *varA FORCEINIT;
-    s2_t *varC;
-    expr_t **varE;
+    size_t varC; /* stack depths, the stacks move when they grow */
+    size_t varE;
     uint8_t tok;
     uint8_t tok2;
     uint8_t var11;
@@ -258,8 +260,9 @@ expr_t *sub_0bfc(void) {
     int16_t var19; /* not used */
     register sym_t *st;
 
-    varE = s13SP;
-    varC = p2List;
+    blkclr(&var8, sizeof(var8)); /* padding included, -P compares nodes word by word */
+    varE = s13End - s13SP;
+    varC = s2End - p2List;
     sub_2529(T_60);
     var11 = 0;
     var19 = 0;
@@ -284,7 +287,7 @@ expr_t *sub_0bfc(void) {
                             var8.dataType = DT_INT;
                             var8.i_sym    = 0;
                             var8.i4       = 0;
-                            st            = sub_4eed(st, T_EXTERN, &var8, 0);
+                            st            = sub_4eed(promoteSym(st), T_EXTERN, &var8, 0);
                             st->m18 |= 0x42;
                             st->m21 = 0;
                             sub_0493(st);
@@ -408,7 +411,7 @@ expr_t *sub_0bfc(void) {
                     if (tok != T_60)
                         ungetTok = tok;
                     varA = popExpr();
-                    if (varA && s13SP == varE)
+                    if (varA && s13SP == s13End - varE)
                         goto done;
                     else
                         goto error;
@@ -433,13 +436,13 @@ expr_t *sub_0bfc(void) {
 error:
     prError("expression syntax");
     skipStmt(tok);
-    while (s13SP != varE)
+    while (s13SP != s13End - varE)
         sub_2569(popExpr());
     varA = NULL;
 
 done:
-    s13SP  = varE;
-    p2List = varC;
+    s13SP  = s13End - varE;
+    p2List = s2End - varC;
     return varA;
 }
 
@@ -574,8 +577,11 @@ expr_t *sub_1441(uint8_t p1, register expr_t *lhs, expr_t *rhs) {
     }
     minusLhsValid = false;
     opFlags       = opTable[p1 - 60].i5;
-    if (p1 == D_ADDRESSOF && lhs->tType == T_ID && (lhs->t_pSym->m18 & 4))
-        prError("can't take address of register variable");
+    if (p1 == D_ADDRESSOF && lhs->tType == T_ID) {
+        if (lhs->t_pSym->m18 & 4)
+            prError("can't take address of register variable");
+        regAddr(lhs->t_pSym);
+    }
 
     if (!(opFlags & 0x100))
         lhs = sub_1e37(lhs);
@@ -583,6 +589,7 @@ expr_t *sub_1441(uint8_t p1, register expr_t *lhs, expr_t *rhs) {
         rhs = sub_1e37(rhs);
 
     if (p1 == T_61) {
+        frameCall(lhs);
         if ((lhs->attr.i4 & 1) && lhs->attr.c7 == SNODE)
             lhs = sub_1441(T_69, lhs, 0); /* dummy 3rd arg */
     } else
@@ -729,9 +736,145 @@ expr_t *sub_1b94(register expr_t *st) {
     return st;
 }
 
+/**************************************************
+ * true if st is an integral type, the types an
+ * integer constant is folded in
+ **************************************************/
+static bool isIntType(register s8_t *st) {
+    return sub_5b08(st) && st->dataType >= DT_CHAR;
+}
+
+/**************************************************
+ * true if st is an integer constant that may be
+ * folded, not one of the shared constants
+ **************************************************/
+static bool isIntConst(register expr_t *st) {
+    return st->tType == T_ICONST && !isStaticExpr(st) && isIntType(&st->attr);
+}
+
+/**************************************************
+ * true if st is an int sized integral type
+ **************************************************/
+static bool isWordType(register s8_t *st) {
+    return isIntType(st) && st->dataType >= DT_INT && st->dataType != DT_LONG &&
+           st->dataType != DT_ULONG;
+}
+
+/**************************************************
+ * true if st is char or unsigned char
+ **************************************************/
+static bool isByteType(register s8_t *st) {
+    return sub_5a76(st, DT_CHAR) || sub_5a76(st, DT_UCHAR);
+}
+
+/**************************************************
+ * num truncated to the width cgen gives dataType
+ **************************************************/
+long normConst(long num, uint8_t dataType) {
+
+    switch (dataType) {
+    case DT_CHAR:
+        return (int8_t)num;
+    case DT_UCHAR:
+        return (uint8_t)num;
+    case DT_LONG:
+        return (int32_t)num;
+    case DT_ULONG:
+        return (uint32_t)num;
+    }
+    return (dataType & DT_UNSIGNED) ? (long)(uint16_t)num : (long)(int16_t)num;
+}
+
+/**************************************************
+ * true if the low 8 bits of the int expression st
+ * can be worked out in char width. That holds for
+ * + - & | ^ ~ and << of operands that can be and
+ * for >> of a char that was widened. cgen cannot
+ * multiply chars
+ **************************************************/
+static bool canNarrow(register expr_t *st, uint8_t dataType) {
+    expr_t *l1;
+
+    switch (st->tType) {
+    case T_ICONST:
+        return isIntType(&st->attr);
+    case T_ID:
+        return st->attr.c7 == SNODE && isWordType(&st->attr);
+    case T_124:
+        l1 = st->t_next;
+        return isWordType(&st->attr) && (isByteType(&l1->attr) || canNarrow(l1, dataType));
+    }
+    if (!isWordType(&st->attr))
+        return false;
+    switch (st->tType) {
+    case T_PLUS:
+    case T_MINUS:
+    case T_BAND:
+    case T_BOR:
+    case T_XOR:
+        return canNarrow(st->t_next, dataType) && canNarrow(st->t_alt, dataType);
+    case 71: /* unary - */
+    case T_BNOT:
+        return canNarrow(st->t_next, dataType);
+    case T_SHL:
+        return isIntConst(st->t_alt) && st->t_alt->t_l >= 0 && st->t_alt->t_l < 8 &&
+               canNarrow(st->t_next, dataType);
+    case T_SHR: /* bits 8 up of a widened char are copies of bit 7 or 0 */
+        l1 = st->t_next;
+        return isIntConst(st->t_alt) && st->t_alt->t_l >= 0 && st->t_alt->t_l < 8 &&
+               l1->tType == T_124 && sub_5a76(&l1->t_next->attr, dataType);
+    case T_QUEST:
+        return canNarrow(st->t_alt, dataType);
+    case T_COLON:
+        return canNarrow(st->t_next, dataType) && canNarrow(st->t_alt, dataType);
+    }
+    return false;
+}
+
+/**************************************************
+ * st, for which canNarrow is true, rewritten to
+ * give its low 8 bits as dataType
+ **************************************************/
+static expr_t *narrowTo(register expr_t *st, uint8_t dataType) {
+    expr_t *l1;
+    s8_t attr;
+
+    blkclr(&attr, sizeof(attr));
+    attr.dataType = dataType;
+    switch (st->tType) {
+    case T_ICONST:
+        return sub_1b4b(normConst(st->t_l, dataType), dataType);
+    case T_124:
+        if (!isByteType(&st->t_next->attr))
+            return narrowTo(st->t_next, dataType);
+        st = st->t_next;
+        if (st->attr.dataType == dataType)
+            return st;
+        /* FALLTHRU */
+    case T_ID:
+        l1       = sub_23b4(T_124, st, allocSType(&attr));
+        l1->attr = attr;
+        return l1;
+    case T_QUEST:
+        st->t_alt = narrowTo(st->t_alt, dataType);
+        break;
+    default:
+        st->t_next = narrowTo(st->t_next, dataType);
+        if (opTable[st->tType - 60].uc4 & 2)
+            st->t_alt = narrowTo(st->t_alt, dataType);
+        break;
+    }
+    st->attr = attr;
+    return st;
+}
+
 /**************************************************
  * 29: 1BF7 PMO +++
  * minor optimiser difference, equivalent code
+ * an integer constant converted to another integral
+ * type is truncated to it, not just retyped. An int
+ * expression converted to char is done in char
+ * width when that gives the same low 8 bits
  **************************************************/
 expr_t *sub_1bf7(register expr_t *st, s8_t *p2) {
     expr_t *var2;
@@ -740,10 +883,15 @@ expr_t *sub_1bf7(register expr_t *st, s8_t *p2) {
         prWarning("%s() declared implicit int", var2->t_pSym->nVName);
         var2->t_pSym->m18 &= ~0x40;
     }
+    if (isByteType(p2) && isWordType(&st->attr) && st->tType != T_ICONST && st->tType != T_ID &&
+        canNarrow(st, p2->dataType))
+        st = narrowTo(st, p2->dataType);
 
     if (!sub_591d(&st->attr, p2)) {
-        if (st->tType != T_ICONST || inData(st))
+        if (st->tType != T_ICONST || isStaticExpr(st))
             st = sub_23b4(T_124, st, allocSType(p2));
+        else if (isIntType(&st->attr) && isIntType(p2))
+            st->t_l = normConst(st->t_l, p2->dataType);
         st->attr = *p2;
     }
     return st;
@@ -755,6 +903,7 @@ expr_t *sub_1bf7(register expr_t *st, s8_t *p2) {
 expr_t *sub_1ccc(expr_t *p1, uint8_t p2) {
     s8_t st;
 
+    blkclr(&st, sizeof(st));
     st.dataType = p2;
     st.i4       = 0;
     st.i_sym    = 0;
@@ -803,11 +952,13 @@ uint8_t sub_1d5a(register s8_t *st, s8_t *p2) {
 
 /**************************************************
  * 33: 1DF0 PMO +++
+ * the address of a function is noted for -G
  **************************************************/
 expr_t *sub_1df0(register expr_t *st) {
 
     if (st->tType != T_ID || st->attr.c7 != ANODE)
         return st;
+    frameAddr(st->t_pSym);
     st->attr.dataType = 0x16;
     st->attr.c7       = SNODE;
     st->a_nextSym     = st->t_pSym;
@@ -911,18 +1062,52 @@ bool sub_2105(register expr_t *st) {
 }
 
 /**************************************************
- * 40: 2157 PMO +++
+ * true if evaluating st has no side effects, so it
+ * may be evaluated again. Only operators known to
+ * be free of them are accepted
  **************************************************/
-bool s13ReleaseFreeList(void) {
-    register expr_t *st;
+bool isPureExpr(register expr_t *st) {
+    uint16_t flags;
 
-    if (s13FreeList == 0)
-        return false;
-    while ((st = s13FreeList)) {
-        s13FreeList = st->t_next;
-        free(st);
+    if (!st)
+        return true;
+    flags = opTable[st->tType - T_60].uc4;
+    if (flags & 1)
+        return true;
+    switch (st->tType) {
+    case T_DOT:
+    case T_POINTER:
+    case T_69:
+    case D_ADDRESSOF:
+    case T_LNOT:
+    case T_BNOT:
+    case T_SIZEOF:
+    case T_STAR:
+    case T_BAND:
+    case T_MINUS:
+    case T_DIV:
+    case T_MOD:
+    case T_PLUS:
+    case T_SHR:
+    case T_SHL:
+    case T_LT:
+    case T_GT:
+    case T_LE:
+    case T_GE:
+    case T_EQEQ:
+    case T_NE:
+    case T_XOR:
+    case T_BOR:
+    case T_LAND:
+    case T_LOR:
+    case T_QUEST:
+    case T_COLON:
+    case T_COMMA:
+    case T_124:
+    case T_125:
+        return isPureExpr(st->t_next) && (!(flags & 2) || isPureExpr(st->t_alt));
     }
-    return true;
+    return false; /* assignments, ++, -- and calls */
 }
 
 /**************************************************
@@ -931,12 +1116,8 @@ bool s13ReleaseFreeList(void) {
 expr_t *s13Alloc(uint8_t tok) {
     register expr_t *st;
 
-    if (s13FreeList != 0) {
-        st          = s13FreeList;
-        s13FreeList = st->t_next;
-        blkclr(st, sizeof(expr_t));
-    } else
-        st = xalloc(sizeof(expr_t));
+    st                = arenaAlloc(sizeof(expr_t));
+    statAlloc(AK_EXPR, sizeof(expr_t));
     st->tType         = tok;
     st->attr.dataType = DT_VOID;
     return st;
@@ -963,18 +1144,287 @@ expr_t *sub_21c7(register expr_t *st) {
     return l1;
 }
 
+/**************************************************
+ * the size cgen gives an object of type st, -1 if
+ * it is not known here. Z80 data is not aligned so
+ * a struct is the sum of its members. The size of
+ * enums depends on their range and bitfields share
+ * words, both are left to cgen
+ **************************************************/
+long typeSize(register s8_t *st) {
+    s8_t elem;
+    sym_t *pm;
+    long size;
+    long n;
+
+    if (st->c7 == ANODE)
+        return -1;
+    if (st->c7 == ENODE) {
+        if (!st->i_expr || st->i_expr->tType != T_ICONST)
+            return -1;
+        elem    = *st;
+        elem.c7 = SNODE;
+        if ((size = typeSize(&elem)) < 0)
+            return -1;
+        return size * st->i_expr->t_l;
+    }
+    if (st->i4)
+        return (st->i4 & 1) ? 2 : -1;
+    switch (st->dataType) {
+    case DT_CHAR:
+    case DT_UCHAR:
+        return 1;
+    case DT_SHORT:
+    case DT_USHORT:
+    case DT_INT:
+    case DT_UINT:
+    case DT_CONST:
+    case DT_UCONST:
+        return 2;
+    case DT_LONG:
+    case DT_ULONG:
+    case DT_FLOAT:
+    case DT_DOUBLE:
+        return 4;
+    case DT_POINTER:
+        return typeSize(st->i_nextInfo);
+    case DT_STRUCT:
+    case DT_UNION:
+        if (!st->i_nextSym || !(st->i_nextSym->m18 & 1))
+            return -1;
+        size = 0;
+        for (pm = st->i_nextSym->nMemberList; pm != st->i_nextSym; pm = pm->nMemberList) {
+            if ((pm->m18 & 0x400) || (n = typeSize(&pm->attr)) < 0)
+                return -1;
+            if (st->dataType == DT_STRUCT)
+                size += n;
+            else if (n > size)
+                size = n;
+        }
+        return size ? size : -1;
+    }
+    return -1;
+}
+
+/**************************************************
+ * the integer constant p1 applied to the constants
+ * st and p3, NULL if it cannot be folded here.
+ * Arithmetic is done in the width cgen uses for
+ * the type of st
+ **************************************************/
+static expr_t *foldConst(uint8_t p1, register expr_t *st, expr_t *p3) {
+    uint8_t dt;
+    int width;
+    long l;
+    long r;
+
+    if (!isIntConst(st) || ((opTable[p1 - 60].uc4 & 2) && !isIntConst(p3)))
+        return NULL;
+    dt    = st->attr.dataType;
+    width = (dt == DT_LONG || dt == DT_ULONG) ? 32 : 16;
+    l     = normConst(st->t_l, dt);
+    r     = (opTable[p1 - 60].uc4 & 2) ? normConst(p3->t_l, p3->attr.dataType) : 0;
+    switch (p1) {
+    case 71: /* unary - */
+        l = (long)(0UL - (unsigned long)l);
+        break;
+    case T_BNOT:
+        l = ~l;
+        break;
+    case T_STAR:
+        l = (long)((unsigned long)l * (unsigned long)r);
+        break;
+    case T_DIV:
+    case T_MOD:
+        if (r == 0)
+            return NULL;
+        l = p1 == T_DIV ? l / r : l % r;
+        break;
+    case T_PLUS:
+        l = (long)((unsigned long)l + (unsigned long)r);
+        break;
+    case T_MINUS:
+        l = (long)((unsigned long)l - (unsigned long)r);
+        break;
+    case T_SHL:
+    case T_SHR:
+        if (r < 0 || r >= width)
+            return NULL;
+        l = p1 == T_SHL ? (long)((unsigned long)l << r) : l >> r;
+        break;
+    case T_BAND:
+        l &= r;
+        break;
+    case T_BOR:
+        l |= r;
+        break;
+    case T_XOR:
+        l ^= r;
+        break;
+    default:
+        return NULL;
+    }
+    p3       = sub_1b4b(normConst(l, dt), dt);
+    p3->attr = st->attr;
+    return p3;
+}
+
+/**************************************************
+ * true if st may be evaluated more than once at
+ * little cost, a variable or a conversion of one
+ **************************************************/
+static bool isCheap(register expr_t *st) {
+
+    if (st->tType == T_124 && isIntType(&st->t_next->attr))
+        st = st->t_next;
+    return st->tType == T_ID && st->attr.c7 == SNODE;
+}
+
+/**************************************************
+ * st << n, just st if n is 0
+ **************************************************/
+static expr_t *shiftBy(register expr_t *st, int n) {
+
+    if (n == 0)
+        return st;
+    return sub_225a(T_SHL, st, sub_1b4b((long)n, st->attr.dataType));
+}
+
+/**************************************************
+ * st * num as two shifts and an add or subtract
+ * when num is 2^a + 2^b or 2^a - 2^b. cgen turns
+ * other multiplies into a call of amul or lmul.
+ * Powers of 2 are already shifted by cgen
+ **************************************************/
+static expr_t *mulShift(register expr_t *st, long num) {
+    uint16_t k;
+    int a;
+    int b;
+
+    k = (uint16_t)num;
+    if ((k & (k - 1)) == 0)
+        return NULL;
+    for (b = 0; !(k & (1 << b)); b++)
+        ;
+    if (((k - (1 << b)) & (k - (1 << b) - 1)) == 0) { /* 2^a + 2^b */
+        for (a = b + 1; (1 << a) != k - (1 << b); a++)
+            ;
+        return sub_225a(T_PLUS, shiftBy(st, a), shiftBy(sub_21c7(st), b));
+    }
+    if (((k + (1 << b)) & (k + (1 << b) - 1)) == 0 && k + (1 << b) <= 0x8000) { /* 2^a - 2^b */
+        for (a = b + 1; (1L << a) != k + (1 << b); a++)
+            ;
+        return sub_225a(T_MINUS, shiftBy(st, a), shiftBy(sub_21c7(st), b));
+    }
+    return NULL;
+}
+
+/**************************************************
+ * signed st / 2^n as (st < 0 ? st + 2^n - 1 : st) >> n
+ * cgen calls adiv for any signed division
+ **************************************************/
+static expr_t *divShift(register expr_t *st, long num) {
+    expr_t *l1;
+    int n;
+
+    if (num < 2 || num > 0x4000 || (num & (num - 1)))
+        return NULL;
+    for (n = 0; (1L << n) != num; n++)
+        ;
+    l1 = sub_1441(T_LT, st, sub_1b4b(0L, st->attr.dataType));
+    l1 = sub_1441(T_QUEST, l1,
+                  sub_1441(T_COLON,
+                           sub_1441(T_PLUS, sub_21c7(st), sub_1b4b(num - 1, st->attr.dataType)),
+                           sub_21c7(st)));
+    return sub_225a(T_SHR, l1, sub_1b4b((long)n, st->attr.dataType));
+}
+
+/**************************************************
+ * p1 applied to st and p3 when it can be done
+ * better here than by cgen. Integer constants are
+ * folded, sizeof a complete type becomes its size,
+ * identities are dropped unless that would make
+ * an lvalue of the result, and int multiplies and
+ * signed divides by constants become shifts
+ **************************************************/
+static expr_t *reduceExpr(uint8_t p1, register expr_t *st, expr_t *p3) {
+    expr_t *l1;
+    s8_t tmp;
+    long size;
+
+    if ((l1 = foldConst(p1, st, p3)))
+        return l1;
+    if (p1 == T_SIZEOF && st->tType == S_TYPE) {
+        tmp = st->attr;
+        if (tmp.c7 == ENODE) /* # of an array type is the size of an element */
+            tmp.c7 = SNODE;
+        if ((size = typeSize(&tmp)) < 0)
+            return NULL;
+        return sub_1b4b(size, DT_INT);
+    }
+    if (!(opTable[p1 - 60].uc4 & 2) || !isWordType(&st->attr) || !sub_591d(&st->attr, &p3->attr))
+        return NULL;
+    if (isIntConst(p3)) {
+        switch (p1) {
+        case T_PLUS:
+        case T_MINUS:
+        case T_SHL:
+        case T_SHR:
+        case T_BOR:
+        case T_XOR:
+            if (p3->t_l == 0 && !sub_1ef1(st))
+                return st;
+            break;
+        case T_STAR:
+            if (p3->t_l == 1 && !sub_1ef1(st))
+                return st;
+            if (isCheap(st))
+                return mulShift(st, p3->t_l);
+            break;
+        case T_DIV:
+            if (p3->t_l == 1 && !sub_1ef1(st))
+                return st;
+            if (!(st->attr.dataType & DT_UNSIGNED) && isCheap(st))
+                return divShift(st, p3->t_l);
+            break;
+        }
+    } else if (isIntConst(st)) {
+        switch (p1) {
+        case T_PLUS:
+        case T_BOR:
+        case T_XOR:
+            if (st->t_l == 0 && !sub_1ef1(p3))
+                return p3;
+            break;
+        case T_STAR:
+            if (st->t_l == 1 && !sub_1ef1(p3))
+                return p3;
+            if (isCheap(p3))
+                return mulShift(p3, st->t_l);
+            break;
+        }
+    }
+    return NULL;
+}
+
 /**************************************************
  * 43: 225A PMO +++
  * uint8_t parameter
+ * an expression that can be simplified is replaced
+ * by its reduced form
  **************************************************/
 expr_t *sub_225a(uint8_t p1, register expr_t *st, expr_t *p3) {
     expr_t *l1;
 
     if (p1 == T_124 && st->tType == T_ICONST) {
+        if (!isStaticExpr(st) && isIntType(&st->attr) && isIntType(&p3->attr))
+            st->t_l = normConst(st->t_l, p3->attr.dataType);
         st->attr = p3->attr;
         sub_2569(p3);
         return st;
     }
+    if ((l1 = reduceExpr(p1, st, p3)))
+        return l1;
     l1 = sub_23b4(p1, st, p3); /* m1:  */
 
     switch (opTable[p1 - 60].c7) {
@@ -1024,10 +1474,15 @@ expr_t *sub_23b4(uint8_t tok, register expr_t *st, expr_t *p3) {
 /**************************************************
  * 45: 240E PMO +++
  * uint8_t parameter
+ * a local kept in __frame is used through its
+ * place there
  **************************************************/
 expr_t *allocId(register sym_t *st) {
     expr_t *pi;
 
+    if (st->frameOff)
+        return frameRef(st);
+    regUse(st);
     pi         = s13Alloc(T_ID);
     pi->t_pSym = st;
     if ((st->m18 & 0x10) || st->m20 == D_MEMBER)
@@ -1075,10 +1530,33 @@ expr_t *allocSType(s8_t *p1) {
 
 /**************************************************
  * 49: 24DE PMO +++
+ * was complexErr, "expression too complex" when
+ * either stack was full. They now double in size,
+ * the entries in use are moved to the new top
  **************************************************/
-void complexErr(void) {
-
-    fatalErr("expression too complex");
+static void growStacks(void) {
+    size_t size;
+    expr_t **ps;
+    s2_t *p2;
+
+    if (s13SP == s13Stk) {
+        size = s13End - s13Stk;
+        ps   = xalloc(size * 2 * sizeof(ps[0]));
+        memcpy(ps + size, s13Stk, size * sizeof(ps[0]));
+        free(s13Stk);
+        s13Stk = ps;
+        s13End = ps + size * 2;
+        s13SP  = ps + size;
+    }
+    if (p2List == s2_9cf3) {
+        size = s2End - s2_9cf3;
+        p2   = xalloc((size * 2 + 1) * sizeof(p2[0]));
+        memcpy(p2 + size, s2_9cf3, size * sizeof(p2[0]));
+        free(s2_9cf3);
+        s2_9cf3 = p2;
+        s2End   = p2 + size * 2;
+        p2List  = p2 + size;
+    }
 }
 
 /**************************************************
@@ -1087,7 +1565,7 @@ void complexErr(void) {
 void pushS13(expr_t *p1) {
 
     if (s13SP == s13Stk)
-        complexErr();
+        growStacks();
     *(--s13SP) = p1;
 }
 
@@ -1096,7 +1574,7 @@ void pushS13(expr_t *p1) {
  **************************************************/
 expr_t *popExpr(void) {
 
-    if (s13SP != &s13Stk[20])
+    if (s13SP != s13End)
         return *(s13SP++);
     return NULL;
 }
@@ -1108,7 +1586,7 @@ void sub_2529(uint8_t p1) {
     register s2_t *st;
 
     if (p2List == s2_9cf3)
-        complexErr();
+        growStacks();
     (--p2List)->type1    = p1;
     (st = p2List)->type2 = opTable[p1 - 60].c3;
 }
@@ -1121,28 +1599,6 @@ uint8_t sub_255d(void) {
     return (p2List++)->type1;
 }
 
-/**************************************************
- * 54: 2569 PMO +++
- **************************************************/
-void sub_2569(register expr_t *st) {
-    uint8_t type;
-
-    if (st) {
-        type = st->tType;
-        if (!(opTable[type - 60].uc4 & 1) && type != T_120) {
-            sub_2569(st->t_next);
-            if (opTable[type - 60].uc4 & 2)
-                sub_2569(st->t_alt);
-        }
-        if (!inData(st)) {
-            if (type == T_FCONST)
-                free(st->t_s);
-            st->t_next  = s13FreeList; /* m2: */
-            s13FreeList = st;
-        }
-    }
-}
-
 /**************************************************
  * 55: 25F7 PMO +++
  * uint8_t parameter + minor optimisation difference
@@ -1151,7 +1607,7 @@ void sub_2569(register expr_t *st) {
 expr_t *sub_25f7(register expr_t *st) {
 
     if (st) {
-        if (!inData(st) && st->tType == T_ICONST) {
+        if (!isStaticExpr(st) && st->tType == T_ICONST) {
             st->t_ul += 1;
         } else if (st->tType == T_PLUS)
             st->t_alt = sub_25f7(st->t_alt);
@@ -1160,3 +1616,27 @@ expr_t *sub_25f7(register expr_t *st) {
     }
     return st; /* m4: */
 }
+
+/**************************************************
+ * restore the initial parser state before the next
+ * translation unit of -batch
+ **************************************************/
+void resetExpr(void) {
+    if (!s13Stk) {
+        s13Stk  = xalloc(EXPRSTKINIT * sizeof(s13Stk[0]));
+        s13End  = s13Stk + EXPRSTKINIT;
+        s2_9cf3 = xalloc((EXPRSTKINIT + 1) * sizeof(s2_9cf3[0]));
+        s2End   = s2_9cf3 + EXPRSTKINIT;
+    }
+    s13SP      = s13End; /* sub_07e3 ran before the first allocation */
+    p2List     = s2End;
+    strId      = 0;
+    byte_8f85  = 0;
+    byte_8f86  = false;
+    byte_968b  = 0;
+    word_968c  = 0;
+    tmpLabelId = 0;
+    byte_9d37  = 0;
+    blkclr(s2_9cf3, (s2End - s2_9cf3 + 1) * sizeof(s2_9cf3[0]));
+    blkclr(s13Stk, (s13End - s13Stk) * sizeof(s13Stk[0]));
+}
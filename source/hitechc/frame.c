@@ -0,0 +1,499 @@
+/*
+ * frame.c - overlaid static frames for the locals of non-reentrant functions, -G and -F
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * -Gfile and -Ffile, the locals of functions that are never re-entered
+ * kept at fixed addresses rather than on the stack, where cgen3 reaches
+ * them with (ix+d).
+ *
+ * A first compile of every unit of the program with -Gfile appends to
+ * file the functions each unit defines, with the bytes of locals they
+ * could give up, the calls they make by name and the functions whose
+ * address is taken:
+ *
+ *     f name size
+ *     c caller callee
+ *     a name
+ *
+ * A static function is named name@file, file being the unit's first
+ * line marker. The second compile with -Ffile reads the lot back. A
+ * function is left alone if it can call itself, directly or through
+ * others, or can run from a function whose address is taken, as that
+ * may be called through a pointer at any time, an interrupt handler
+ * included. The locals of the other functions are given places in one
+ * area, __frame, placed so that no two functions that can be active at
+ * once overlap, and are used through *(type *)(__frame + offset). The
+ * unit defining main also defines the area.
+ *
+ * Only scalars, pointers and structs are moved, arrays and register
+ * variables stay on the stack, as do all the locals of a function with
+ * assembler in it. Calls by name from assembler or library
+ * code are not seen, a function called that way must have its address
+ * taken somewhere to be left alone.
+ */
+#define KEYMAX (33 + sizeof(srcFile)) /* a name, @ and a file */
+
+typedef struct {
+    char *name;
+    int32_t size; /* bytes of locals */
+    int32_t off;  /* their place in __frame, -1 if they stay on the stack */
+} frame_t;
+
+char *graphFile; /* -G */
+char *frameFile; /* -F */
+
+static frame_t *frames; /* sorted by name */
+static int frameCnt;
+static int32_t frameTotal; /* size of __frame */
+
+static TLS char *graphBuf; /* records for graphFile */
+static TLS size_t graphLen;
+static TLS size_t graphMax;
+static TLS char *unitName;      /* first line marker */
+static TLS char funcKey[KEYMAX]; /* the function being compiled, "" outside */
+static TLS frame_t *curFrame;   /* and its place, NULL if on the stack */
+static TLS int32_t frameUsed;   /* bytes of its locals so far */
+static TLS bool funcAsm;        /* it has assembler, which may use (ix+d) */
+static TLS sym_t *areaSym;      /* __frame */
+static TLS bool mainHere;
+
+/* the graph while -F reads it */
+typedef struct {
+    char *name;
+    int32_t size;
+    bool defined;
+    bool entry;   /* address taken */
+    bool reached; /* from an entry */
+    bool unsafe;
+    int32_t edge; /* first of its calls in edges */
+    int32_t scc;
+    int32_t index;
+    int32_t low;
+} gnode_t;
+
+static gnode_t *nodes;
+static int32_t *edges; /* callee of each call, grouped by caller */
+static int32_t *sccStk;
+static int32_t sccSP;
+static int32_t *popped; /* the nodes by component, callees first */
+static int32_t popCnt;
+static int32_t sccCnt;
+static int32_t visitCnt;
+
+/**************************************************
+ * qsort order of names
+ **************************************************/
+static int cmpName(const void *p1, const void *p2) {
+    return strcmp(*(char **)p1, *(char **)p2);
+}
+
+/**************************************************
+ * the node of name among the cnt sorted nodes
+ **************************************************/
+static int32_t nodeNum(char *name, int32_t cnt) {
+    gnode_t *pn;
+
+    pn = bsearch(&name, nodes, cnt, sizeof(gnode_t), cmpName);
+    return (int32_t)(pn - nodes);
+}
+
+/**************************************************
+ * Tarjan's strongly connected components, numbered
+ * callees first. A node in a loop of calls is
+ * unsafe
+ **************************************************/
+static void sccVisit(int32_t n) {
+    register gnode_t *pn;
+    int32_t i;
+    int32_t m;
+
+    pn              = &nodes[n];
+    pn->index       = pn->low = ++visitCnt;
+    sccStk[sccSP++] = n;
+    for (i = pn->edge; i < pn[1].edge; i++) {
+        m = edges[i];
+        if (m == n)
+            pn->unsafe = true;
+        if (!nodes[m].index) {
+            sccVisit(m);
+            if (nodes[m].low < pn->low)
+                pn->low = nodes[m].low;
+        } else if (nodes[m].scc < 0 && nodes[m].index < pn->low)
+            pn->low = nodes[m].index;
+    }
+    if (pn->low == pn->index) {
+        do {
+            m                = sccStk[--sccSP];
+            nodes[m].scc     = sccCnt;
+            popped[popCnt++] = m;
+            if (m != n)
+                nodes[m].unsafe = pn->unsafe = true;
+        } while (m != n);
+        sccCnt++;
+    }
+}
+
+/**************************************************
+ * mark n and what it can call as reached
+ **************************************************/
+static void reach(int32_t n) {
+    int32_t i;
+
+    nodes[n].reached = true;
+    for (i = nodes[n].edge; i < nodes[n + 1].edge; i++)
+        if (!nodes[edges[i]].reached)
+            reach(edges[i]);
+}
+
+/**************************************************
+ * read the call graph written by the -G compiles
+ * and place the frames of the functions that are
+ * safe
+ **************************************************/
+void frameLoad(char *file) {
+    FILE *fp;
+    char line[16 + 2 * KEYMAX];
+    char a[sizeof(line)];
+    char b[sizeof(line)];
+    char **recs; /* kind, name, name or size */
+    int32_t recCnt;
+    int32_t recMax;
+    char **names;
+    int32_t cnt;
+    int32_t i;
+    int32_t n;
+    int32_t *fill;
+    int32_t *sccOff;
+    int32_t off;
+    char kind;
+    register gnode_t *pn;
+
+    if (!(fp = fopen(file, "r")))
+        fatalErr("can't open %s", file);
+    recs   = NULL;
+    recCnt = recMax = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        b[0] = '\0';
+        if (sscanf(line, "%c %s %s", &kind, a, b) < 2 || !strchr("fca", kind) ||
+            (kind != 'a' && !b[0]))
+            fatalErr("%s: bad call graph record %s", file, line);
+        if (recCnt == recMax && !(recs = realloc(recs, (recMax += 3 * 256) * sizeof(char *))))
+            fatalErr("Out of memory");
+        recs[recCnt++] = kind == 'f' ? "f" : kind == 'c' ? "c" : "a";
+        recs[recCnt++] = strcpy(xalloc(strlen(a) + 1), a);
+        recs[recCnt++] = strcpy(xalloc(strlen(b) + 1), b);
+    }
+    fclose(fp);
+
+    /* a node for each name, in order */
+    names = xalloc((recCnt / 3 * 2 + 1) * sizeof(char *));
+    for (cnt = i = 0; i < recCnt; i += 3) {
+        names[cnt++] = recs[i + 1];
+        if (*recs[i] == 'c')
+            names[cnt++] = recs[i + 2];
+    }
+    qsort(names, cnt, sizeof(char *), cmpName);
+    nodes = xalloc((cnt + 1) * sizeof(gnode_t));
+    for (n = i = 0; i < cnt; i++)
+        if (!n || strcmp(names[i], nodes[n - 1].name)) {
+            blkclr(&nodes[n], sizeof(gnode_t));
+            nodes[n].name  = names[i];
+            nodes[n++].scc = -1;
+        }
+    blkclr(&nodes[n], sizeof(gnode_t));
+    cnt = n;
+
+    /* the calls grouped by caller */
+    for (i = 0; i < recCnt; i += 3) {
+        pn = &nodes[nodeNum(recs[i + 1], cnt)];
+        if (*recs[i] == 'f') {
+            pn->defined = true;
+            if (atol(recs[i + 2]) > pn->size)
+                pn->size = atol(recs[i + 2]);
+        } else if (*recs[i] == 'a')
+            pn->entry = true;
+        else
+            pn[1].edge++;
+    }
+    for (n = 0; n < cnt; n++)
+        nodes[n + 1].edge += nodes[n].edge;
+    edges = xalloc((nodes[cnt].edge + 1) * sizeof(int32_t));
+    fill  = xalloc((cnt + 1) * sizeof(int32_t)); /* next free edge of each caller */
+    for (n = 0; n <= cnt; n++)
+        fill[n] = nodes[n].edge;
+    for (i = 0; i < recCnt; i += 3)
+        if (*recs[i] == 'c')
+            edges[fill[nodeNum(recs[i + 1], cnt)]++] = nodeNum(recs[i + 2], cnt);
+    free(fill);
+
+    sccStk = xalloc((cnt + 1) * sizeof(int32_t));
+    popped = xalloc((cnt + 1) * sizeof(int32_t));
+    sccSP = sccCnt = visitCnt = popCnt = 0;
+    for (n = 0; n < cnt; n++)
+        if (!nodes[n].index)
+            sccVisit(n);
+    for (n = 0; n < cnt; n++)
+        if (nodes[n].entry && !nodes[n].reached)
+            reach(n);
+
+    /* taken in reverse the components come callers first,
+     * each frame goes above those of the callers that can
+     * be active with it */
+    sccOff = xalloc((sccCnt + 1) * sizeof(int32_t));
+    blkclr(sccOff, (sccCnt + 1) * sizeof(int32_t));
+    for (n = popCnt; n--;) {
+        pn  = &nodes[popped[n]];
+        off = sccOff[pn->scc];
+        if (pn->defined && !pn->unsafe && !pn->reached)
+            off += pn->size;
+        for (i = pn->edge; i < pn[1].edge; i++)
+            if (nodes[edges[i]].scc != pn->scc && sccOff[nodes[edges[i]].scc] < off)
+                sccOff[nodes[edges[i]].scc] = off;
+    }
+    frames = xalloc((cnt + 1) * sizeof(frame_t));
+    for (frameCnt = frameTotal = 0, n = 0; n < cnt; n++)
+        if ((pn = &nodes[n])->defined) {
+            frames[frameCnt].name = pn->name;
+            frames[frameCnt].size = pn->size;
+            if (pn->unsafe || pn->reached || !pn->size)
+                frames[frameCnt++].off = -1;
+            else {
+                frames[frameCnt++].off = off = sccOff[pn->scc];
+                if (off + pn->size > frameTotal)
+                    frameTotal = off + pn->size;
+            }
+        }
+    free(sccOff);
+    free(popped);
+    free(sccStk);
+    free(edges);
+    free(nodes);
+    free(names);
+    free(recs); /* the names are kept by frames */
+}
+
+/**************************************************
+ * start on a new unit
+ **************************************************/
+void frameReset(void) {
+    graphLen   = 0;
+    unitName   = NULL;
+    funcKey[0] = '\0';
+    curFrame   = NULL;
+    areaSym    = NULL;
+    mainHere   = false;
+}
+
+/**************************************************
+ * a line marker naming file, the first names the
+ * unit
+ **************************************************/
+void frameUnit(char *file) {
+    if (!unitName)
+        unitName = file;
+}
+
+/**************************************************
+ * add a record to those written to graphFile
+ **************************************************/
+static void graphAdd(char kind, char *a, char *b) {
+    size_t len;
+
+    len = strlen(a) + strlen(b) + 4;
+    if (graphLen + len > graphMax &&
+        !(graphBuf = realloc(graphBuf, graphMax += len > 4096 ? len : 4096)))
+        fatalErr("Out of memory");
+    graphLen += sprintf(graphBuf + graphLen, *b ? "%c %s %s\n" : "%c %s\n", kind, a, b);
+}
+
+/**************************************************
+ * the graph's name for function st, in buf
+ **************************************************/
+static char *keyOf(register sym_t *st, char *buf) {
+    register char *s;
+
+    strcpy(buf, st->nVName);
+    if (st->m20 == T_STATIC) {
+        s = buf + strlen(buf);
+        *s++ = '@';
+        snprintf(s, KEYMAX - 33, "%s", unitName ? unitName : srcFile);
+        for (; *s; s++)
+            if (*s == ' ' || *s == '\t')
+                *s = '?';
+    }
+    return buf;
+}
+
+/**************************************************
+ * look up the frame of a function
+ **************************************************/
+static frame_t *findFrame(char *key) {
+    return bsearch(&key, frames, frameCnt, sizeof(frame_t), cmpName);
+}
+
+/**************************************************
+ * __frame, an array of char of unknown size
+ **************************************************/
+static sym_t *frameArea(void) {
+    register sym_t *st;
+
+    if (!(st = areaSym)) {
+        st                = areaSym = arenaAllocIn(&tuArena, sizeof(sym_t));
+        st->nVName        = intern("__frame", 7);
+        st->hash          = nameOf(st->nVName)->hash;
+        st->m18           = 0x10;
+        st->m20           = T_EXTERN;
+        st->attr.c7       = ENODE;
+        st->attr.dataType = DT_CHAR;
+        st->attr.i_expr   = &s13_9d1b;
+    }
+    return st;
+}
+
+/**************************************************
+ * the body of function st is next
+ **************************************************/
+void frameEnter(register sym_t *st) {
+    frame_t *pf;
+
+    if (!graphFile && !frameFile)
+        return;
+    keyOf(st, funcKey);
+    frameUsed = 0;
+    curFrame  = NULL;
+    funcAsm   = false;
+    if (frameFile) {
+        if (!(pf = findFrame(funcKey)))
+            prError("%s is not in the call graph %s", funcKey, frameFile);
+        else if (pf->off >= 0) {
+            curFrame = pf;
+            /* declared once, outside any body */
+            if (!(frameArea()->m18 & 0x100))
+                sub_0493(areaSym);
+        }
+    }
+    if (strcmp(st->nVName, "main") == 0 && st->m20 != T_STATIC)
+        mainHere = true;
+}
+
+/**************************************************
+ * the body is done
+ **************************************************/
+void frameLeave(void) {
+    char size[12];
+
+    if (!funcKey[0])
+        return;
+    if (graphFile) {
+        sprintf(size, "%ld", funcAsm ? 0L : (long)frameUsed);
+        graphAdd('f', funcKey, size);
+    }
+    if (curFrame && (frameUsed > curFrame->size || funcAsm))
+        prError("%s: call graph %s is out of date", funcKey, frameFile);
+    funcKey[0] = '\0';
+    curFrame   = NULL;
+}
+
+/**************************************************
+ * a local st of the current function has been
+ * declared, give it a place in the frame if it
+ * can have one. Both passes count the same bytes
+ **************************************************/
+void frameLocal(register sym_t *st) {
+    long size;
+
+    if (!funcKey[0] || st->m20 != T_AUTO || (st->m18 & 4) || st->attr.c7 != SNODE ||
+        (size = typeSize(&st->attr)) <= 0)
+        return;
+    if (curFrame)
+        st->frameOff = curFrame->off + frameUsed + 1;
+    frameUsed += size;
+}
+
+/**************************************************
+ * the function has assembler in it, its locals
+ * stay on the stack
+ **************************************************/
+void frameAsm(void) {
+    funcAsm = true;
+}
+
+/**************************************************
+ * st, the left of a call, is about to be called
+ **************************************************/
+void frameCall(register expr_t *st) {
+    char key[KEYMAX];
+
+    if (graphFile && funcKey[0] && st->tType == T_ID && st->attr.c7 == ANODE)
+        graphAdd('c', funcKey, keyOf(st->t_pSym, key));
+}
+
+/**************************************************
+ * the address of function st is taken
+ **************************************************/
+void frameAddr(register sym_t *st) {
+    char key[KEYMAX];
+
+    if (graphFile)
+        graphAdd('a', keyOf(st, key), "");
+}
+
+/**************************************************
+ * *(type *)(__frame + offset), the place of the
+ * local st
+ **************************************************/
+expr_t *frameRef(register sym_t *st) {
+    expr_t *pe;
+    s8_t attr;
+
+    attr = st->attr;
+    sub_5be1(&attr);
+    pe = sub_1441(T_PLUS, allocId(areaSym), sub_1b4b(st->frameOff - 1, DT_INT));
+    pe = sub_1441(T_124, pe, allocSType(&attr));
+    return sub_1441(T_69, pe, 0);
+}
+
+/**************************************************
+ * the unit is done, write its part of the call
+ * graph. The unit with main defines __frame
+ **************************************************/
+void frameEnd(void) {
+    register sym_t *st;
+    FILE *fp;
+    bool ok;
+
+    if (graphFile && graphLen) {
+        if (!(fp = fopen(graphFile, "a")))
+            prError("can't write %s", graphFile);
+        else {
+            /* in one write, so units compiled at once do not mix */
+            setvbuf(fp, NULL, _IOFBF, graphLen);
+            ok = fwrite(graphBuf, 1, graphLen, fp) == graphLen;
+            if (fclose(fp) == EOF || !ok)
+                prError("can't write %s", graphFile);
+        }
+    }
+    if (frameFile && mainHere && frameTotal) {
+        st              = frameArea();
+        st->m18        |= 1;
+        st->attr.i_expr = sub_1b4b(frameTotal, DT_CONST);
+        sub_0493(st);
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * intern.c - interning of identifiers and source file names for p1x3
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Identifier intern pool.
+ * Every spelling seen by the lexer is stored once, so names can be
+ * compared by pointer. The name_t header in front of the characters
+ * holds the hash used by the symbol table and, for keywords, the token.
+ */
+#define NAMETABINIT 1024 /* must be a power of 2 */
+
+static TLS arena_t nameArena; /* names live for the whole run */
+static TLS name_t **nameTab;
+static TLS uint32_t nameTabSize;
+static TLS uint32_t nameCnt;
+static TLS char **srcNames; /* interned file names, indexed by id */
+static TLS int16_t srcCnt;
+static TLS int16_t srcMax;
+
+/**************************************************
+ * FNV-1a hash of len characters
+ **************************************************/
+uint32_t hashName(register char *s, int16_t len) {
+    uint32_t h;
+
+    for (h = 2166136261u; len--; s++)
+        h = (h ^ *(uint8_t *)s) * 16777619u;
+    return h;
+}
+
+/**************************************************
+ * double the pool's buckets
+ **************************************************/
+static void growNameTab(void) {
+    name_t **newTab;
+    name_t *np;
+    uint32_t i;
+
+    newTab = xalloc(nameTabSize * 2 * sizeof(newTab[0]));
+    for (i = 0; i < nameTabSize; i++)
+        while ((np = nameTab[i])) {
+            nameTab[i]                               = np->next;
+            np->next                                 = newTab[np->hash & (nameTabSize * 2 - 1)];
+            newTab[np->hash & (nameTabSize * 2 - 1)] = np;
+        }
+    free(nameTab);
+    nameTab = newTab;
+    nameTabSize *= 2;
+}
+
+/**************************************************
+ * return the unique copy of the len characters at s
+ **************************************************/
+char *intern(char *s, int16_t len) {
+    uint32_t hash;
+    register name_t *np;
+
+    hash = hashName(s, len);
+    for (np = nameTab[hash & (nameTabSize - 1)]; np; np = np->next)
+        if (np->hash == hash && np->len == len && memcmp(np->s, s, len) == 0) {
+            allocStats[AK_NAME].shared++;
+            return np->s;
+        }
+    if (++nameCnt > nameTabSize)
+        growNameTab();
+    np       = arenaAllocIn(&nameArena, sizeof(name_t) + len);
+    statAlloc(AK_NAME, sizeof(name_t) + len);
+    np->hash = hash;
+    np->len  = len;
+    memcpy(np->s, s, len);
+    np->next                           = nameTab[hash & (nameTabSize - 1)];
+    nameTab[hash & (nameTabSize - 1)] = np;
+    return np->s;
+}
+
+/**************************************************
+ * create the pool and enter the keywords
+ **************************************************/
+void initNames(void) {
+    uint8_t tok;
+
+    nameTabSize = NAMETABINIT;
+    nameTab     = xalloc(nameTabSize * sizeof(nameTab[0]));
+    for (tok = T_ASM; tok <= T_WHILE; tok++)
+        if (tok != T_CONST)
+            nameOf(intern(keywords[tok - T_ASM], (int16_t)strlen(keywords[tok - T_ASM])))->tok =
+                tok;
+    nameOf(intern("const", 5))->tok = T_CONST;
+    blank                            = intern("", 0);
+    srcFileId(blank);
+}
+
+/**************************************************
+ * return the number given to the source file name,
+ * so line records can compare files without strcmp.
+ * "" is always 0
+ **************************************************/
+int16_t srcFileId(char *name) {
+    char *s;
+    register int16_t i;
+
+    s = intern(name, (int16_t)strlen(name));
+    for (i = srcCnt; --i >= 0;)
+        if (srcNames[i] == s)
+            return i;
+    if (srcCnt == srcMax) {
+        srcMax += 16;
+        if (!(srcNames = realloc(srcNames, srcMax * sizeof(srcNames[0]))))
+            fatalErr("Out of memory");
+    }
+    srcNames[srcCnt] = s;
+    return srcCnt++;
+}
+
+/**************************************************
+ * the name given the number id by srcFileId
+ **************************************************/
+char *srcFileName(int16_t id) {
+    return srcNames[id];
+}
+
+static TLS void (*nameFn)(char *s);
+
+static void walkBlock(char *p, size_t len) {
+    char *end;
+
+    for (end = p + len; p < end; p += (sizeof(name_t) + ((name_t *)p)->len + ARENAALIGN - 1) & ~(ARENAALIGN - 1))
+        nameFn(((name_t *)p)->s);
+}
+
+/**************************************************
+ * call fn for every name in the pool, in the order
+ * they were entered
+ **************************************************/
+void walkNames(void (*fn)(char *s)) {
+    nameFn = fn;
+    arenaWalk(&nameArena, walkBlock);
+}
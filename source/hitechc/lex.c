@@ -30,6 +30,10 @@
  * 10-Jul-2022
  */
 #include "p1.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMDSCAN
+#endif
 
 char *keywords[] = { /* 8f87 */
                      "asm",      "auto",   "break",  "case",   "char",   "continue", "default",
@@ -39,18 +43,44 @@ char *keywords[] = { /* 8f87 */
                      "unsigned", "void",   "while"
 };
 
-char lastEmitSrc[64];  /* 9d60 */
-bool sInfoEmitted;     /* 9da0 */
-int16_t inCnt;         /* 9da1 */
-char lastEmitFunc[40]; /* 9da3 */
-YYTYPE yylval;         /* 9dcb */
-char nameBuf[32];      /* 9dcf */
-uint8_t ungetTok;      /* 9def */
+TLS int16_t lastErrSrcId;  /* 9d60 was lastEmitSrc[64] */
+TLS bool sInfoEmitted;     /* 9da0 */
+TLS int32_t inCnt;         /* 9da1 */
+TLS char lastEmitFunc[40]; /* 9da3 */
+TLS YYTYPE yylval;         /* 9dcb */
+TLS char nameBuf[32];      /* 9dcf */
+TLS char *lastName;        /* interned copy of nameBuf */
+TLS uint8_t ungetTok;      /* 9def */
+TLS bool tokConst;         /* const came before the last token */
+
+TLS int32_t strChCnt;    /* 9df0 */
+TLS bool lInfoEmitted;   /* 9df2 */
+TLS int32_t startTokCnt; /* 9df3 */
+TLS int16_t ungetCh;     /*  9df5 */
+
+/*
+ * The whole input is read into inData once. Each line is terminated in
+ * place by overwriting the character after its '\n' with '\0' (saved in
+ * nextCh), so inBuf points at an ordinary string holding the current line,
+ * as the original 512 byte fgets buffer did, but without a length limit.
+ * INPAD zero bytes follow the data so the vector scans can read ahead.
+ */
+#define INPAD 64
+static char noInput[INPAD]; /* inBuf before the first line */
+TLS char *inBuf = noInput;  /* current line */
+static TLS char *inData;    /* whole input */
+static TLS char *inEnd;     /* end of input data */
+static TLS char *inNext;    /* start of the line after inBuf */
+static TLS char nextCh;     /* character overwritten at inNext */
+static TLS bool inEof;      /* sticky end of input */
+TLS FILE *inFp;             /* source being compiled */
 
-int16_t strChCnt;    /* 9df0 */
-bool lInfoEmitted;   /* 9df2 */
-int16_t startTokCnt; /* 9df3 */
-int16_t ungetCh;     /*  9df5 */
+static char *scanBlanksScalar(register char *s);
+static char *scanIdentScalar(register char *s);
+static char *scanDigitsScalar(register char *s);
+static TLS char *(*scanBlanks)(char *s) = scanBlanksScalar; /* ' ' and '\t' */
+static TLS char *(*scanIdent)(char *s)  = scanIdentScalar;  /* [A-Za-z0-9_] */
+static TLS char *(*scanDigits)(char *s) = scanDigitsScalar; /* [0-9] */
 
 uint8_t parseNumber(int16_t ch);
 uint8_t parseName(int8_t ch);
@@ -60,25 +90,28 @@ int16_t getCh(void);
 void prErrMsg(void);
 int16_t skipWs(void);
 int8_t escCh(int16_t ch);
+static bool nextLine(void);
+static void initScan(void);
 
 
 /**************************************************
  * 56: 2671 PMO +++
  * location of two basic blocks swapped, code equivalent
  **************************************************/
-uint8_t yylex(void) {
+static uint8_t lexToken(void) {
     int16_t ch;
     uint8_t tok;
-    char buf[50];
+    char buf[sizeof(srcFile)];
     register char *s;
 
     if (ungetTok) {
         tok      = ungetTok;
         ungetTok = 0;
         if (tok == T_ID && byte_8f86)
-            yylval.ySym = sub_4e90(nameBuf);
+            yylval.ySym = sub_4e90(lastName);
         return tok;
     }
+    tokConst = false;
     for (;;) {
         ch          = skipWs();
         startTokCnt = inCnt;
@@ -94,13 +127,14 @@ uint8_t yylex(void) {
                 ch = getCh();
             } while (Isspace(ch) && ch != '\n');
             if (Isdigit(ch) && parseNumber(ch) == T_ICONST) {
-                lineNo = (int16_t)(yylval.yNum - 1);
+                lineNo = yylval.yNum - 1;
                 do {
                     ch = getCh();
                 } while (Isspace(ch) && ch != '\n');
                 if (ch == '"') {
                     for (s = buf; (ch = getCh()) != '"' && ch != '\n';)
-                        *s++ = (char)ch;
+                        if (s < buf + sizeof(buf) - 1)
+                            *s++ = (char)ch;
                     *s = '\0';
                     if (buf[0])
                         strcpy(srcFile, buf);
@@ -108,6 +142,10 @@ uint8_t yylex(void) {
                         strcpy(srcFile, srcFileArg);
                     else
                         *srcFile = '\0';
+                    srcId = srcFileId(srcFile);
+                    frameUnit(srcFileName(srcId));
+                    if (wantDeps)
+                        depAdd(srcFileName(srcId));
                     if (crfFp)
                         fprintf(crfFp, "~%s\n", srcFile);
                 }
@@ -115,11 +153,12 @@ uint8_t yylex(void) {
             } else {
                 s = buf;
                 do {
-                    *s++ = (char)ch;
-                    ch   = getCh();
-                } while (ch != '\n' && !Isspace(ch));
+                    if (s < buf + sizeof(buf) - 1)
+                        *s++ = (char)ch;
+                    ch = getCh();
+                } while (ch != '\n' && ch != EOF && !Isspace(ch));
                 *s = '\0';
-                while (ch != '\n')
+                while (ch != '\n' && ch != EOF)
                     ch = getCh();
                 if (strcmp(buf, "asm") == 0) {
                     parseAsm();
@@ -140,7 +179,7 @@ uint8_t yylex(void) {
             else if (ch != '\'')
                 prError("char const too long");
 
-            while (ch != '\n' && ch != '\'')
+            while (ch != '\n' && ch != '\'' && ch != EOF)
                 ch = getCh();
             return T_ICONST;
         case ';':
@@ -294,6 +333,22 @@ uint8_t yylex(void) {
     }
 }
 
+/**************************************************
+ * the next token, under -stats the time spent in
+ * the lexer is charged to its own phase
+ **************************************************/
+uint8_t yylex(void) {
+    uint8_t tok;
+    int phase;
+
+    if (!statsOpt)
+        return lexToken();
+    phase = statsPhase(PH_LEX);
+    tok   = lexToken();
+    statsPhase(phase);
+    return tok;
+}
+
 /**************************************************
  * 57: 2CC3 PMO +++
  * two blocks change from ex de,hl ld de,xxx
@@ -305,11 +360,21 @@ uint8_t parseNumber(int16_t ch) {
     uint8_t base;
     char buf[50];
     uint8_t digit;
+    char *run;
     register char *s = buf;
 
     while (Isdigit(ch)) {
-        *s++ = (char)ch;
-        ch   = getCh();
+        if (s < buf + sizeof(buf) - 2)
+            *s++ = (char)ch;
+        if (!ungetCh && !inEof) { /* rest of the run straight from the line */
+            run = scanDigits(inBuf + inCnt);
+            while (inBuf + inCnt < run) {
+                if (s < buf + sizeof(buf) - 2)
+                    *s++ = inBuf[inCnt];
+                inCnt++;
+            }
+        }
+        ch = getCh();
     }
     if (ch == '.' || ch == 'e' || ch == 'E') {
         if (ch == '.')
@@ -336,7 +401,8 @@ uint8_t parseNumber(int16_t ch) {
         *s++      = 0;
         if (*buf == '.')
             s++;
-        yylval.yStr = xalloc(s - buf);
+        yylval.yStr = arenaAlloc(s - buf);
+        statAlloc(AK_STRING, s - buf);
         if (*buf == '.')
             strcat(strcpy(yylval.yStr, "0"), buf);
         else
@@ -385,15 +451,13 @@ uint8_t parseNumber(int16_t ch) {
 
 /**************************************************
  * 58: 2F75 PMO +++
- * uses ld hl,xxx ex de,hl compared to ex de,hl ld de,xxx
- * equivalent code
+ * the name is interned, keywords are recognised by
+ * the token stored with their pool entry
  **************************************************/
 uint8_t parseName(int8_t ch) {
     int16_t len;
-    uint8_t mid;
-    uint8_t lo;
-    uint8_t hi;
-    int16_t cmp;
+    uint8_t tok;
+    char *run;
     register char *s = nameBuf;
 
     len              = 0;
@@ -402,32 +466,33 @@ uint8_t parseName(int8_t ch) {
             *s++ = ch;
             len++;
         }
+        if (!ungetCh && !inEof) { /* rest of the run straight from the line */
+            run = scanIdent(inBuf + inCnt);
+            while (inBuf + inCnt < run) {
+                if (len != sizeof(nameBuf) - 1) {
+                    *s++ = inBuf[inCnt];
+                    len++;
+                }
+                inCnt++;
+            }
+        }
         ch = (int8_t)getCh();
     } while (Isalnum(ch));
-    ungetCh = ch;
-    *s      = 0;
-    /* Handle 'const' keyword explicitly - it's not in sorted position in keywords array */
-    if (strcmp(nameBuf, "const") == 0) {
-        return yylex();  /* ignore const, get next token */
-    }
-    lo      = T_ASM;
-    hi      = T_WHILE;
-    do {
-        mid = (lo + hi) / 2;
-        cmp = (int16_t)strcmp(nameBuf, keywords[mid - T_ASM]);
-        if (cmp <= 0)
-            hi = mid - 1;
-        if (cmp >= 0)
-            lo = mid + 1;
-    } while (hi >= lo);
-    if (hi < lo - 1) {
-        switch (mid) {
+    ungetCh  = ch;
+    *s       = 0;
+    lastName = intern(nameBuf, len);
+    if ((tok = nameOf(lastName)->tok)) {
+        switch (tok) {
+        case T_CONST: /* noted against the next token */
+            tok      = yylex();
+            tokConst = true;
+            return tok;
         case T_AUTO:
         case T_EXTERN:
         case T_REGISTER:
         case T_STATIC:
         case T_TYPEDEF:
-            yylval.yVal = mid;
+            yylval.yVal = tok;
             return S_CLASS;
         case T_CHAR:
         case T_DOUBLE:
@@ -440,35 +505,58 @@ uint8_t parseName(int8_t ch) {
         case T_UNION:
         case T_UNSIGNED:
         case T_VOID:
-            yylval.yVal = mid;
+            yylval.yVal = tok;
             return S_TYPE;
         case _T_SIZEOF:
             return T_SIZEOF;
         }
-        return mid;
+        return tok;
     }
-    yylval.ySym = sub_4e90(nameBuf);
+    yylval.ySym = sub_4e90(lastName);
     return T_ID;
 }
 
+/**************************************************
+ * double the size of a scratch buffer, returns the
+ * position corresponding to s in the new buffer
+ **************************************************/
+static char *growBuf(char **pbuf, size_t *psize, char *s) {
+    size_t used = s - *pbuf;
+
+    if (!(*pbuf = realloc(*pbuf, *psize *= 2)))
+        fatalErr("Out of memory");
+    return *pbuf + used;
+}
+
 /**************************************************
  * 59: 308B PMO +++
  **************************************************/
 void parseAsm(void) {
     int16_t ch;
-    char buf[512];
+    static TLS char *buf;
+    static TLS size_t bufSize;
     register char *s;
 
+    if (!buf)
+        buf = xalloc(bufSize = 512);
     for (;;) {
         s = buf;
-        while ((ch = getCh()) != '\n' && ch != EOF)
+        while ((ch = getCh()) != '\n' && ch != EOF) {
+            if (s + 1 >= buf + bufSize) /* lines are no longer limited to 512 bytes */
+                s = growBuf(&buf, &bufSize, s);
             *s++ = (char)ch;
+        }
         *s = 0;
         if (ch == EOF)
             fatalErr("EOF in #asm");
         if (strncmp(buf, "#endasm", 7) == 0)
             return;
-        printf(";; %s\n", buf);
+        dataPsect = false; /* the text may change psect */
+        frameAsm();
+        regAsm();
+        outStr(&irOut, ";; ");
+        outStr(&irOut, buf);
+        outCh(&irOut, '\n');
     }
 }
 
@@ -477,17 +565,22 @@ void parseAsm(void) {
  * one basic block relocated. Code equivalent
  **************************************************/
 void parseString(int16_t ch) {
-    char *var2;
     char *var4;
-    char buf[1024];
-    register char *s = buf;
+    static TLS char *buf;
+    static TLS size_t bufSize;
+    register char *s;
 
+    if (!buf)
+        buf = xalloc(bufSize = 1024);
+    s = buf;
     while (ch == '"') {
         while ((ch = getCh()) != '"') {
-            if (ch == '\n') {
+            if (ch == '\n' || ch == EOF) {
                 expectErr("closing quote");
                 break;
             }
+            if (s + 1 >= buf + bufSize) /* was fixed at 1024 */
+                s = growBuf(&buf, &bufSize, s);
             if (ch == '\\') {
                 if ((ch = getCh()) != '\n')
                     *s++ = escCh(ch);
@@ -498,18 +591,144 @@ void parseString(int16_t ch) {
     }
     ungetCh  = ch;
     *s       = 0;
-    strChCnt = (int16_t)(s - buf);
-    var2 = var4 = xalloc(strChCnt + 1);
-    ch          = strChCnt + 1; /* unwound memcpy. Note strcpy cannot handle embedded '\0' */
-    s           = buf;
-    while (ch--)
-        *var2++ = *s++;
+    strChCnt = (int32_t)(s - buf);
+    var4     = xalloc(strChCnt + 1);
+    statAlloc(AK_STRING, strChCnt + 1);
+    memcpy(var4, buf, strChCnt + 1); /* strcpy cannot handle embedded '\0' */
     yylval.yStr = var4;
 }
 
+/**************************************************
+ * read the whole of inFp into inData
+ **************************************************/
+static void loadInput(void) {
+    size_t size;
+    size_t len;
+    size_t n;
+
+    len  = 0;
+    size = 0x10000;
+    if (!(inData = malloc(size + INPAD)))
+        fatalErr("Out of memory");
+    while ((n = fread(inData + len, 1, size - len, inFp)) > 0)
+        if ((len += n) == size && !(inData = realloc(inData, (size *= 2) + INPAD)))
+            fatalErr("Out of memory");
+    memset(inData + len, 0, INPAD);
+    initScan();
+    inNext = inData;
+    inEnd  = inData + len;
+}
+
+/**************************************************
+ * forget the input and lexer state so the next
+ * translation unit of -batch reads its input afresh
+ **************************************************/
+void resetLex(void) {
+    free(inData);
+    inData       = inEnd = inNext = NULL;
+    nextCh       = 0;
+    inEof        = false;
+    inBuf        = noInput;
+    inCnt        = 0;
+    startTokCnt  = 0;
+    ungetCh      = 0;
+    ungetTok     = 0;
+    strChCnt     = 0;
+    sInfoEmitted = false;
+    lInfoEmitted = false;
+    lastErrSrcId = 0;
+    *lastEmitFunc = '\0';
+    *nameBuf      = '\0';
+    lastName      = NULL;
+    blkclr(&yylval, sizeof(yylval));
+}
+
+/**************************************************
+ * if the line at s is a line marker, # n "name",
+ * return the name and set *len, else NULL
+ **************************************************/
+char *lineMarker(register char *s, char *end, size_t *len) {
+    char *name;
+
+    if (s == end || *s++ != '#')
+        return NULL;
+    while (s < end && (*s == ' ' || *s == '\t'))
+        s++;
+    if (s == end || !Isdigit(*s))
+        return NULL;
+    while (s < end && Isdigit(*s))
+        s++;
+    while (s < end && (*s == ' ' || *s == '\t'))
+        s++;
+    if (s == end || *s++ != '"')
+        return NULL;
+    for (name = s; s < end && *s != '"' && *s != '\n'; s++)
+        ;
+    if (s == end || *s != '"')
+        return NULL;
+    *len = s - name;
+    return name;
+}
+
+/**************************************************
+ * the whole input, read before the first line is
+ * taken so a precompiled header can be matched
+ **************************************************/
+char *lexInput(size_t *len) {
+    if (!inData) {
+        loadInput();
+        nextCh = *inNext; /* as nextLine puts it back */
+    }
+    *len = inEnd - inData;
+    return inData;
+}
+
+/**************************************************
+ * carry on lexing from the line starting offset
+ * bytes into the input, as if everything before it
+ * had been read
+ **************************************************/
+void resumeLex(size_t offset) {
+    inNext      = inData + offset;
+    nextCh      = *inNext;
+    *inNext     = '\0';
+    inBuf       = inNext; /* empty, so getCh moves to the next line */
+    inCnt       = 0;
+    startTokCnt = 0;
+    ungetCh     = 0;
+    ungetTok    = 0;
+    inEof       = false;
+}
+
+/**************************************************
+ * make inBuf the next line of input, false at EOF
+ **************************************************/
+static bool nextLine(void) {
+    char *nl;
+
+    if (!inData)
+        loadInput();
+    else
+        *inNext = nextCh;
+    if (inNext >= inEnd) {
+        *inNext = '\0'; /* inBuf keeps the last line for messages */
+        inEof   = true;
+        return false;
+    }
+    inBuf = inNext;
+    if ((nl = memchr(inBuf, '\n', inEnd - inBuf)))
+        inNext = nl + 1;
+    else
+        inNext = inEnd;
+    nextCh  = *inNext;
+    *inNext = '\0';
+    return true;
+}
+
 /**************************************************
  * 61: 320D PMO +++
- * move of 2 basic blocks code equivalent
+ * lines now come from the buffered input and end
+ * of input is sticky
  **************************************************/
 int16_t getCh(void) {
     int16_t ch;
@@ -519,13 +738,15 @@ int16_t getCh(void) {
         if (ungetCh) {
             ch      = ungetCh;
             ungetCh = 0;
-        } else if ((ch = inBuf[inCnt++]) == 0) {
+        } else if (inEof)
+            return EOF;
+        else if ((ch = inBuf[inCnt++]) == 0) {
             if (s_opt)
                 emitSrcInfo();
             sInfoEmitted = false;
             lInfoEmitted = false;
 
-            if (!fgets(inBuf, 512, stdin))
+            if (!nextLine())
                 return EOF;
             ch          = inBuf[0];
             inCnt       = 1;
@@ -535,8 +756,10 @@ int16_t getCh(void) {
                 prErrMsg();
         }
 #if !defined(CPM) && !defined(_WIN32)
-        if (ch == 0x1a)
+        if (ch == 0x1a) {
+            inEof = true;
             return EOF;
+        }
     } while (ch == '\r');
 #endif
     return ch;
@@ -550,16 +773,16 @@ void prErrMsg(void) {
     if (!lInfoEmitted) {
         iy = depth ? curFuncNode->nVName : "";
 
-        if (!l_opt && (strcmp(srcFile, lastEmitSrc) || strcmp(iy, lastEmitFunc))) {
-            fprintf(stderr, "%s:", srcFile);
+        if (!l_opt && (srcId != lastErrSrcId || strcmp(iy, lastEmitFunc))) {
+            fprintf(errFp, "%s:", srcFile);
             if (*iy)
-                fprintf(stderr, " %s()\n", iy);
+                fprintf(errFp, " %s()\n", iy);
             else
-                fputc('\n', stderr);
-            strcpy(lastEmitSrc, srcFile);
+                fputc('\n', errFp);
+            lastErrSrcId = srcId;
             strcpy(lastEmitFunc, iy);
         }
-        fprintf(stderr, "%6d:\t%s", lineNo, inBuf);
+        fprintf(errFp, "%6d:\t%s", lineNo, inBuf);
         lInfoEmitted = true;
     }
 }
@@ -568,22 +791,22 @@ void prErrMsg(void) {
  * 63: 3350 PMO +++
  **************************************************/
 void prMsgAt(register char *buf) {
-    int16_t i;
+    int32_t i;
     uint16_t col;
     prErrMsg();
     if (!*inBuf)
-        fputs(buf, stderr);
+        fputs(buf, errFp);
     else {
-        fputc('\t', stderr);
+        fputc('\t', errFp);
         for (col = i = 0; i < startTokCnt - 1; i++)
             if (inBuf[i] == '\t')
                 col = (col + 8) & 0xfff8;
             else
                 col++;
         if (strlen(buf) + 1 < col)
-            fprintf(stderr, "%*s ^ ", col - 1, buf);
+            fprintf(errFp, "%*s ^ ", col - 1, buf);
         else
-            fprintf(stderr, "%*c %s", col + 1, '^', buf);
+            fprintf(errFp, "%*c %s", col + 1, '^', buf);
     }
 }
 
@@ -596,8 +819,14 @@ void emitSrcInfo(void) {
     if (!sInfoEmitted && inBuf[0]) {
         for (s = inBuf; *s && Isspace(*s); s++)
             ;
-        if (*s && *s != '#')
-            printf(";; ;%s: %d: %s", srcFile, lineNo, inBuf);
+        if (*s && *s != '#') {
+            outStr(&irOut, ";; ;");
+            outStr(&irOut, srcFile);
+            outStr(&irOut, ": ");
+            outNum(&irOut, lineNo);
+            outStr(&irOut, ": ");
+            outStr(&irOut, inBuf);
+        }
     }
     sInfoEmitted = true;
 }
@@ -609,8 +838,12 @@ void emitSrcInfo(void) {
  **************************************************/
 int16_t skipWs(void) {
     int16_t ch;
+
+    if (!ungetCh && !inEof)
+        inCnt = (int32_t)(scanBlanks(inBuf + inCnt) - inBuf);
     while (Isspace(ch = getCh()))
-        ;
+        if (!ungetCh && !inEof)
+            inCnt = (int32_t)(scanBlanks(inBuf + inCnt) - inBuf);
     return ch;
 }
 
@@ -717,3 +950,130 @@ void skipToSemi(void) {
     } while (tok != T_SEMI);
     ungetTok = T_SEMI;
 }
+
+/*
+ * Run scanners used by skipWs, parseName and parseNumber. Each returns
+ * the first character at or after s that is not in its class. The input
+ * line is '\0' terminated and followed by at least INPAD readable bytes,
+ * so the vector versions may load whole blocks past the stopping point.
+ */
+static char *scanBlanksScalar(register char *s) {
+    while (*s == ' ' || *s == '\t')
+        s++;
+    return s;
+}
+
+static char *scanIdentScalar(register char *s) {
+    while (*s > 0 && Isalnum(*s))
+        s++;
+    return s;
+}
+
+static char *scanDigitsScalar(register char *s) {
+    while (*s >= '0' && *s <= '9')
+        s++;
+    return s;
+}
+
+#ifdef SIMDSCAN
+/* bytes of v in lo..hi, the classes are all ASCII so signed compares work */
+#define IN16(v, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8((hi) + 1)))
+#define IN32(v, lo, hi)                                                \
+    _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((lo) - 1)), \
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), v))
+
+__attribute__((target("sse2"))) static char *scanBlanksSse2(register char *s) {
+    __m128i v;
+    uint32_t stop;
+
+    for (;; s += 16) {
+        v    = _mm_loadu_si128((__m128i *)s);
+        stop = ~_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')))) &
+               0xffff;
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+
+__attribute__((target("sse2"))) static char *scanIdentSse2(register char *s) {
+    __m128i v;
+    uint32_t stop;
+
+    for (;; s += 16) {
+        v    = _mm_loadu_si128((__m128i *)s);
+        stop = ~_mm_movemask_epi8(_mm_or_si128(
+                   _mm_or_si128(IN16(v, 'a', 'z'), IN16(v, 'A', 'Z')),
+                   _mm_or_si128(IN16(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))))) &
+               0xffff;
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+
+__attribute__((target("sse2"))) static char *scanDigitsSse2(register char *s) {
+    uint32_t stop;
+
+    for (;; s += 16) {
+        stop = ~_mm_movemask_epi8(IN16(_mm_loadu_si128((__m128i *)s), '0', '9')) & 0xffff;
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+
+__attribute__((target("avx2"))) static char *scanBlanksAvx2(register char *s) {
+    __m256i v;
+    uint32_t stop;
+
+    for (;; s += 32) {
+        v    = _mm256_loadu_si256((__m256i *)s);
+        stop = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))));
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+
+__attribute__((target("avx2"))) static char *scanIdentAvx2(register char *s) {
+    __m256i v;
+    uint32_t stop;
+
+    for (;; s += 32) {
+        v    = _mm256_loadu_si256((__m256i *)s);
+        stop = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(IN32(v, 'a', 'z'), IN32(v, 'A', 'Z')),
+            _mm256_or_si256(IN32(v, '0', '9'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')))));
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+
+__attribute__((target("avx2"))) static char *scanDigitsAvx2(register char *s) {
+    uint32_t stop;
+
+    for (;; s += 32) {
+        stop = ~(uint32_t)_mm256_movemask_epi8(IN32(_mm256_loadu_si256((__m256i *)s), '0', '9'));
+        if (stop)
+            return s + __builtin_ctz(stop);
+    }
+}
+#endif
+
+/**************************************************
+ * pick the widest scanners the host supports
+ **************************************************/
+static void initScan(void) {
+#ifdef SIMDSCAN
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanBlanks = scanBlanksAvx2;
+        scanIdent  = scanIdentAvx2;
+        scanDigits = scanDigitsAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scanBlanks = scanBlanksSse2;
+        scanIdent  = scanIdentSse2;
+        scanDigits = scanDigitsSse2;
+    }
+#endif
+}
@@ -30,21 +30,34 @@
  * 10-Jul-2022
  */
 #include "p1.h"
+#include <setjmp.h>
+#if !defined(CPM) && !defined(_WIN32)
+#define THREADS
+#include <pthread.h>
+#define MAXJOBS 256
+#endif
 
-char *tmpFile = "p1.tmp"; /* 91db */
-char errBuf[512];         /* 9df7 */
-FILE *crfFp;              /* 9ff7 */
-char crfNameBuf[30];      /* 9ff9 */
-char srcFile[100];        /* a017 */
-char *crfFile;            /* a07b */
-bool s_opt;               /* a07d */
-bool w_opt;               /* a07e */
-int16_t lineNo;           /* a07f */
-char *srcFileArg;         /* a081 */
-bool l_opt;               /* a083 */
-FILE *tmpFp;              /* a084 */
-char inBuf[512];          /* a086 */
-int16_t errCnt;           /* a286 */
+char *tmpFile;           /* 91db spill file for tmpOut, normally unnamed */
+char errBuf[512];        /* 9df7 */
+TLS FILE *crfFp;         /* 9ff7 */
+TLS char crfNameBuf[30]; /* 9ff9 */
+TLS char srcFile[100];   /* a017 */
+TLS int16_t srcId;       /* srcFileId(srcFile) */
+char *crfFile;           /* a07b */
+bool s_opt;              /* a07d */
+bool w_opt;              /* a07e */
+TLS int32_t lineNo;      /* a07f */
+TLS char *srcFileArg;    /* a081 */
+bool l_opt;              /* a083 */
+TLS int16_t errCnt;      /* a286 */
+bool b_opt;              /* -batch, many units per run */
+int jobs;                /* -j threads for -batch */
+static char *pchOut;     /* -P precompiled header to write */
+static char *pchIn;      /* -U precompiled header to use */
+static char *serverSock; /* --server socket */
+TLS FILE *errFp;         /* diagnostics, a buffer per unit under -j */
+
+static TLS jmp_buf unitJmp; /* fatalErr in -batch abandons the unit */
 
 int main(int argc, char *argv[]);
 #ifdef CPM
@@ -56,6 +69,8 @@ void prMsg(char *fmt, va_list args);
 void copyTmp(void);
 void closeFiles(void);
 void sub_3abf(void);
+static bool runUnit(char *in, char *out);
+static bool batch(int argc, char *argv[]);
 
 /**************************************************
  * 71: 367E PMO +++
@@ -63,10 +78,11 @@ void sub_3abf(void);
  * strcpy 2nd arg optimisation missed
  **************************************************/
 int main(int argc, char *argv[]) {
-    register char *st;
-
-    initMemAddr(); /* get data area range */
+    FILE *in;
+    char *sock;
+    int status;
 
+    errFp = stderr;
     for (--argc, ++argv; argc && *argv[0] == '-'; --argc, argv++) {
         switch (argv[0][1]) {
         case 'E':
@@ -76,7 +92,12 @@ int main(int argc, char *argv[]) {
             break;
         case 'S':
         case 's':
-            s_opt = true;
+            if (strcmp(argv[0], "-stats") == 0)
+                statsOpt = STATS_TEXT;
+            else if (strcmp(argv[0], "-stats=json") == 0)
+                statsOpt = STATS_JSON;
+            else
+                s_opt = true;
             break;
         case 'W':
         case 'w':
@@ -86,17 +107,83 @@ int main(int argc, char *argv[]) {
         case 'l':
             l_opt = true;
             break;
+        case 'H':
+        case 'h':
+            h_opt = true;
+            break;
+        case 'A':
+        case 'a':
+            a_opt = true;
+            break;
+        case 'B':
+        case 'b':
+            b_opt = true;
+            break;
+        case 'J':
+        case 'j':
+#ifdef THREADS
+            if (!(jobs = atoi(argv[0] + 2)))
+                jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+            break;
+        case 'P':
+        case 'p':
+            pchOut = argv[0] + 2;
+            break;
+        case 'U':
+        case 'u':
+            pchIn = argv[0] + 2;
+            break;
+        case 'M':
+        case 'm':
+            depFile = argv[0] + 2;
+            break;
+        case 'G':
+        case 'g':
+            graphFile = argv[0] + 2;
+            break;
+        case 'F':
+        case 'f':
+            frameFile = argv[0] + 2;
+            break;
+        case '-':
+            if (strcmp(argv[0], "--server") == 0 || strncmp(argv[0], "--server=", 9) == 0)
+                serverSock = argv[0][8] ? argv[0] + 9 : "";
+            break;
         case 'C':
         case 'c':
             if (argv[0][2])
                 crfFile = argv[0] + 2;
             else
-                crfFile = crfNameBuf;
+                crfFile = ""; /* named after the source */
             break;
         }
     }
-    sub_4d92();
-    sub_07e3();
+    initNames();
+    if ((graphFile && !*graphFile) || (frameFile && !*frameFile))
+        fatalErr("-G and -F need a file name");
+    if (frameFile)
+        frameLoad(frameFile);
+#ifdef THREADS
+    if (pchOut) {
+        if (argc != 1)
+            fatalErr("-P needs just the header's preprocessed input");
+        strcpy(srcFile, argv[0]);
+        exit(!pchCreate(argv[0], pchOut));
+    }
+    if (pchIn)
+        pchRead(pchIn);
+    if (serverSock)
+        serve(*serverSock ? serverSock : getenv("P1X3_SERVER"));
+#endif
+    if (depFile && b_opt) {
+        b_opt = false;
+        fatalErr("-M can't be used with -batch");
+    }
+    if (depFile && !*depFile)
+        fatalErr("-M needs a file name");
+    if (b_opt)
+        exit(!batch(argc, argv));
     if (argc) {
         if (freopen(argv[0], "r", stdin) == 0)
             fatalErr("can't open %s", *argv);
@@ -109,22 +196,68 @@ int main(int argc, char *argv[]) {
     } else
         strcpy(srcFile, srcFileArg = "(stdin)");
 
-    if (crfFile) {
-        if (*crfFile == '\0') {
-            crfFile = crfNameBuf;
+    in       = stdin;
+    wantDeps = depFile != NULL;
+#ifdef THREADS
+    if ((sock = getenv("P1X3_SERVER")) && *sock && !crfFile && !graphFile && !frameFile &&
+        !(in = useServer(sock, &status)))
+        errCnt = status; /* the server did it */
+    else
+#endif
+        compileUnit(in, stdout);
+    if (depFile && errCnt == 0)
+        depWrite(depFile);
+    if (fclose(stdout) == -1)
+        prError("close error (disk space?)");
+    closeFiles();
+    exit(errCnt != 0);
+}
+
+/**************************************************
+ * compile srcFile from in to out, starting from a
+ * clean state. true if there were no errors
+ **************************************************/
+bool compileUnit(FILE *in, FILE *out) {
+    register char *st;
+    char *name;
+
+    if (statsOpt)
+        statsReset();
+    sub_4d92();
+    sub_07e3();
+    resetExpr();
+    resetLex();
+    resetArenas();
+    outDiscard(&tmpOut);
+    depth       = 0;
+    byte_a289   = 0;
+    unreachable = false;
+    word_a28b   = 0;
+    curFuncNode = NULL;
+    p25_a28f    = NULL;
+    dataPsect   = false;
+    lineNo      = 0;
+    errCnt      = 0;
+    depReset();
+    frameReset();
+    srcId       = srcFileId(srcFile);
+    inFp        = in;
+    outOpen(&irOut, pchMaking ? NULL : out); /* -P keeps the header's code */
+
+    if ((name = crfFile)) {
+        if (*name == '\0') {
+            name = crfNameBuf;
             strcpy(crfNameBuf, srcFile);
             if ((st = rindex(crfNameBuf, '.')))
                 strcpy(st, ".crf");
             else
                 strcat(crfNameBuf, ".crf");
         }
-        if (!(crfFp = fopen(crfFile, "a")))
-            prWarning("Can't create xref file %s", crfFile);
+        if (!(crfFp = fopen(name, "a")))
+            prWarning("Can't create xref file %s", name);
         else
             fprintf(crfFp, "~%s\n", srcFile);
     }
-    if (!(tmpFp = fopen(tmpFile, "w")))
-        fatalErr("can't open %s", tmpFile);
 
     s13_9d28.tType    = T_ICONST;
     s13_9d1b.tType         = T_ICONST;
@@ -132,13 +265,174 @@ int main(int argc, char *argv[]) {
     s13_9d1b.t_l      = 0;
     s13_9d28.t_l      = 1;
 
+    pchLoad();
     sub_3abf();
+    if (pchMaking)
+        return errCnt == 0;
+    frameEnd();
+    if (statsOpt)
+        statsPhase(PH_EMIT);
     copyTmp();
 
-    if (fclose(stdout) == -1)
+    outFlush(&irOut);
+    if (ferror(out) || fflush(out) == -1)
         prError("close error (disk space?)");
-    closeFiles();
-    exit(errCnt != 0);
+    if (statsOpt)
+        prStats();
+    return errCnt == 0;
+}
+
+/**************************************************
+ * compile srcFile from in to out for -batch or
+ * --server, a fatal error returns here. true if
+ * there were no errors
+ **************************************************/
+bool runStream(FILE *in, FILE *out) {
+    bool ok;
+
+    if (setjmp(unitJmp)) {
+        outFlush(&irOut); /* as much as a single run leaves */
+        ok = false;
+    } else {
+        if (!blank) /* first unit on this thread */
+            initNames();
+        ok = compileUnit(in, out);
+    }
+    if (crfFp) {
+        fclose(crfFp);
+        crfFp = NULL;
+    }
+    return ok;
+}
+
+/**************************************************
+ * compile one -batch pair. true if there were no
+ * errors
+ **************************************************/
+static bool runUnit(char *in, char *out) {
+    FILE *inFile;
+    FILE *outFile;
+    bool ok;
+
+    srcFileArg = in;
+    strcpy(srcFile, in);
+    if (!(inFile = fopen(in, "r"))) {
+        fprintf(errFp, "can't open %s\n", in);
+        return false;
+    }
+    if (!(outFile = fopen(out, "w"))) {
+        fprintf(errFp, "can't open %s\n", out);
+        fclose(inFile);
+        return false;
+    }
+    ok = runStream(inFile, outFile);
+    fclose(inFile);
+    if (fclose(outFile) == -1 && ok) {
+        fprintf(errFp, "%s: close error (disk space?)\n", out);
+        ok = false;
+    }
+    return ok;
+}
+
+#ifdef THREADS
+static pthread_mutex_t batchLock = PTHREAD_MUTEX_INITIALIZER;
+static char **batchArgv; /* pairs not yet taken */
+static int batchLeft;
+static bool batchOk;
+
+/**************************************************
+ * -j worker, takes pairs until none are left. A
+ * unit's messages are collected and written to
+ * stderr together once it is done
+ **************************************************/
+static void *batchWorker(void *arg) {
+    char *in;
+    char *out;
+    char *msg;
+    size_t msgLen;
+    bool ok;
+
+    for (;;) {
+        pthread_mutex_lock(&batchLock);
+        if (batchLeft == 0) {
+            pthread_mutex_unlock(&batchLock);
+            break;
+        }
+        in  = batchArgv[0];
+        out = batchArgv[1];
+        batchArgv += 2;
+        batchLeft -= 2;
+        pthread_mutex_unlock(&batchLock);
+
+        msg    = NULL;
+        msgLen = 0;
+        if (!(errFp = open_memstream(&msg, &msgLen)))
+            errFp = stderr;
+        ok = runUnit(in, out);
+        if (errFp != stderr)
+            fclose(errFp);
+        pthread_mutex_lock(&batchLock);
+        if (msgLen)
+            fwrite(msg, 1, msgLen, stderr);
+        if (!ok)
+            batchOk = false;
+        pthread_mutex_unlock(&batchLock);
+        free(msg);
+    }
+    outDiscard(&tmpOut);
+    return arg;
+}
+
+/**************************************************
+ * run the -batch pairs on up to jobs threads
+ **************************************************/
+static bool batchThreads(int argc, char *argv[]) {
+    pthread_t tids[MAXJOBS];
+    int n;
+    int i;
+
+    batchArgv = argv;
+    batchLeft = argc;
+    batchOk   = true;
+    n         = jobs < MAXJOBS ? jobs : MAXJOBS;
+    if (n > argc / 2)
+        n = argc / 2;
+    for (i = 0; i < n; i++)
+        if (pthread_create(&tids[i], NULL, batchWorker, NULL) != 0)
+            break;
+    if (i == 0) /* no threads, do the work here */
+        batchWorker(NULL);
+    while (i--)
+        pthread_join(tids[i], NULL);
+    return batchOk;
+}
+#endif
+
+/**************************************************
+ * -batch in out [in out ...]
+ * each pair is compiled as if by a separate run,
+ * a fatal error only abandons its own unit.
+ * true if all units compiled without error
+ **************************************************/
+static bool batch(int argc, char *argv[]) {
+    bool ok;
+
+    ok = true;
+    if (argc == 0 || (argc & 1)) {
+        b_opt = false;
+        fatalErr("-batch needs pairs of input and output files");
+    }
+#ifdef THREADS
+    if (jobs > 1)
+        ok = batchThreads(argc, argv);
+    else
+#endif
+        for (; argc; argc -= 2, argv += 2)
+            if (!runUnit(argv[0], argv[1]))
+                ok = false;
+    b_opt = false; /* fatal errors exit again */
+    outDiscard(&tmpOut);
+    return ok;
 }
 
 #ifdef CPM
@@ -161,7 +455,7 @@ void prError(p1, p2, p3) char *p1;
 
     ++errCnt;
     prMsg(p1, p2, p3);
-    fputc('\n', stderr);
+    fputc('\n', errFp);
 }
 
 /**************************************************
@@ -172,6 +466,8 @@ char *p2;
 {
 
     prError(p1, p2);
+    if (b_opt)
+        longjmp(unitJmp, 1);
     closeFiles();
     exit(1);
 }
@@ -184,7 +480,7 @@ void prWarning(p1, p2, p3) char *p1;
     if (w_opt)
         return;
     prMsg(p1, p2, p3);
-    fprintf(stderr, " (warning)\n");
+    fprintf(errFp, " (warning)\n");
 }
 
 #else
@@ -207,7 +503,7 @@ void prError(char *fmt, ...) {
     ++errCnt;
     prMsg(fmt, args);
     va_end(args);
-    fputc('\n', stderr);
+    fputc('\n', errFp);
 }
 
 /**************************************************
@@ -219,7 +515,9 @@ void fatalErr(char *fmt, ...) {
     ++errCnt;
     prMsg(fmt, args);
     va_end(args);
-    fputc('\n', stderr);
+    fputc('\n', errFp);
+    if (b_opt)
+        longjmp(unitJmp, 1);
     closeFiles();
     exit(1);
 }
@@ -234,7 +532,7 @@ void prWarning(char *fmt, ...) {
     va_start(args, fmt);
     prMsg(fmt, args);
     va_end(args);
-    fprintf(stderr, " (warning)\n");
+    fprintf(errFp, " (warning)\n");
 }
 
 
@@ -253,15 +551,22 @@ void expectErr(char *p) {
  * 77: 3A07 PMO +++
  **************************************************/
 void copyTmp(void) {
-    int ch;
-
-    fclose(tmpFp);
-
-    if ((tmpFp = fopen(tmpFile, "r")) == NULL)
-        fatalErr("Can't reopen %s", tmpFile);
-
-    while ((ch = fgetc(tmpFp)) != EOF)
-        fputc(ch, stdout);
+    size_t n;
+
+    outFlush(&irOut);
+    if (tmpOut.fp) { /* spilled to a file */
+        outFlush(&tmpOut);
+        rewind(tmpOut.fp);
+        while ((n = fread(irOut.buf, 1, irOut.end - irOut.buf, tmpOut.fp))) {
+            fwrite(irOut.buf, 1, n, irOut.fp);
+            irOut.total += n;
+        }
+        if (ferror(tmpOut.fp))
+            fatalErr("Can't reread temporary file");
+    } else if (tmpOut.ptr != tmpOut.buf) {
+        fwrite(tmpOut.buf, 1, tmpOut.ptr - tmpOut.buf, irOut.fp);
+        irOut.total += tmpOut.ptr - tmpOut.buf;
+    }
 }
 
 /**************************************************
@@ -270,11 +575,9 @@ void copyTmp(void) {
 void closeFiles(void) {
 
     fclose(stdin);
+    outFlush(&irOut);
     fclose(stdout);
-    if (tmpFp) {
-        fclose(tmpFp);
-        unlink(tmpFile);
-    }
+    outDiscard(&tmpOut);
     if (crfFp) /* PMO - close missing in original */
         fclose(crfFp);
 }
@@ -284,12 +587,8 @@ void closeFiles(void) {
 void *xalloc(size_t size) {
     register char *ptr;
 
-    do {
-        if ((ptr = malloc(size)) != NULL)
-            goto done;
-    } while (releaseNodeFreeList() || s13ReleaseFreeList());
-    fatalErr("Out of memory");
-done:
+    if ((ptr = malloc(size)) == NULL)
+        fatalErr("Out of memory");
     blkclr(ptr, size);
     return ptr;
 }
@@ -299,10 +598,25 @@ done:
  **************************************************/
 void sub_3abf(void) {
     uint8_t tok;
+    bool peeked;
 
+    peeked = false;
+    if (statsOpt)
+        statsPhase(PH_DECL);
     while ((tok = yylex()) != T_EOF) {
         ungetTok = tok;
         sub_3adf();
+        peeked = ungetTok != 0;
+    }
+    if (statsOpt)
+        statsPhase(PH_OTHER);
+    if (pchMaking) { /* saved before the end of unit checks */
+        pchSnap(peeked);
+        return;
     }
+    if (h_opt)
+        prHashStats();
     checkScopeExit();
+    if (a_opt)
+        prArenaStats();
 }
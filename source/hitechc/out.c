@@ -0,0 +1,239 @@
+/*
+ * out.c - buffered writers for p1x3's intermediate code output
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Buffered writer for the .p1 output.
+ * The original produced the intermediate code with printf / putchar
+ * and fprintf, one or two characters at a time. Records are now
+ * assembled in a large buffer that is handed to stdio only when full,
+ * with numbers converted by hand rather than through a format string.
+ *
+ * A writer without a file keeps everything in memory. This is used for
+ * the [a records that the original wrote to p1.tmp and copied to the
+ * end of the output; only when they pass OUTSPILL are they moved to a
+ * private temporary file.
+ */
+#define OUTBUFSIZE 0x40000
+#define OUTMEMINIT 0x1000
+#define OUTSPILL   0x400000
+
+TLS out_t irOut;  /* the .p1 code written to stdout */
+TLS out_t tmpOut; /* [a records, appended to the output by copyTmp */
+
+/* signatures of the basic types, indexed by dataType */
+static char *basicSig[] = { "`?", "`u?", "`b", "`ub", "`c", "`uc", "`s", "`us", "`i",
+                            "`ui", "`l", "`ul", "`x", "`ux", "`f", "`uf", "`d", "`ud",
+                            "`?", "`u?", "`v", "`uv", "`?", "`u?", "`?", "`u?" };
+
+/**************************************************
+ * attach a buffer to fp, NULL keeps the text in
+ * memory
+ **************************************************/
+void outOpen(register out_t *op, FILE *fp) {
+    size_t size;
+
+    if (!op->buf) {
+        size = fp ? OUTBUFSIZE : OUTMEMINIT;
+        if (!(op->buf = malloc(size))) /* no need to clear it */
+            fatalErr("Out of memory");
+        op->end = op->buf + size;
+    }
+    op->ptr   = op->buf;
+    op->fp    = fp;
+    op->total = 0;
+}
+
+/**************************************************
+ * write out the buffered text, write errors are
+ * left on fp for the close check. Does nothing for
+ * an in memory writer
+ **************************************************/
+void outFlush(register out_t *op) {
+    if (op->fp) {
+        if (op->ptr != op->buf)
+            fwrite(op->buf, 1, op->ptr - op->buf, op->fp);
+        op->total += op->ptr - op->buf;
+        op->ptr = op->buf;
+    }
+}
+
+/**************************************************
+ * drop any buffered text, closing the spill file
+ **************************************************/
+void outDiscard(register out_t *op) {
+    if (op->fp) {
+        fclose(op->fp);
+        if (op == &tmpOut && tmpFile)
+            unlink(tmpFile);
+        op->fp = NULL;
+    }
+    op->ptr = op->buf;
+}
+
+/**************************************************
+ * open the file an in memory writer spills to.
+ * It is removed as soon as it is created, unless
+ * named on the command line
+ **************************************************/
+static FILE *openSpill(void) {
+    FILE *fp;
+#if !defined(CPM) && !defined(_WIN32)
+    char name[_MAX_PATH];
+    char *dir;
+    int fd;
+#endif
+
+    if (tmpFile) {
+        if (!(fp = fopen(tmpFile, "w+")))
+            fatalErr("can't open %s", tmpFile);
+        return fp;
+    }
+#if !defined(CPM) && !defined(_WIN32)
+    if (!(dir = getenv("TMPDIR")) || !*dir)
+        dir = "/tmp";
+    snprintf(name, sizeof(name), "%s/p1XXXXXX", dir);
+    if ((fd = mkstemp(name)) < 0 || !(fp = fdopen(fd, "w+")))
+        fatalErr("can't create temporary file %s", name);
+    unlink(name);
+#else
+    if (!(fp = tmpfile()))
+        fatalErr("can't create temporary file");
+#endif
+    return fp;
+}
+
+/**************************************************
+ * make room for at least one more character
+ **************************************************/
+static void makeRoom(register out_t *op) {
+    size_t size;
+    size_t used;
+
+    if (!op->buf)
+        outOpen(op, op->fp);
+    else if (op->fp)
+        outFlush(op);
+    else if ((size = op->end - op->buf) < OUTSPILL) {
+        used = op->ptr - op->buf;
+        if (!(op->buf = realloc(op->buf, size * 2)))
+            fatalErr("Out of memory");
+        op->ptr = op->buf + used;
+        op->end = op->buf + size * 2;
+    } else {
+        op->fp = openSpill();
+        outFlush(op);
+    }
+}
+
+/**************************************************
+ * outCh when the buffer is full
+ **************************************************/
+void outChSlow(register out_t *op, int c) {
+    makeRoom(op);
+    *op->ptr++ = (char)c;
+}
+
+/**************************************************
+ * write len bytes
+ **************************************************/
+void outWrite(register out_t *op, char *s, size_t len) {
+    size_t n;
+
+    if (!op->buf)
+        outOpen(op, op->fp);
+    while ((size_t)(op->end - op->ptr) < len) {
+        n = op->end - op->ptr;
+        memcpy(op->ptr, s, n);
+        op->ptr += n;
+        s += n;
+        len -= n;
+        makeRoom(op);
+    }
+    memcpy(op->ptr, s, len);
+    op->ptr += len;
+}
+
+/**************************************************
+ * write a '\0' terminated string
+ **************************************************/
+void outStr(out_t *op, char *s) {
+    outWrite(op, s, strlen(s));
+}
+
+/**************************************************
+ * write n in decimal, as printf("%ld")
+ **************************************************/
+void outNum(out_t *op, long n) {
+    char buf[24];
+    register char *s;
+    unsigned long u;
+
+    s  = buf + sizeof(buf);
+    u  = n < 0 ? -(unsigned long)n : (unsigned long)n;
+    do {
+        *--s = (char)('0' + u % 10);
+    } while ((u /= 10));
+    if (n < 0)
+        *--s = '-';
+    outWrite(op, s, buf + sizeof(buf) - s);
+}
+
+/**************************************************
+ * write a constant initialiser record, as
+ * "-> n `sig\n", for a basic data type. Used for
+ * the elements of large tables, so the record is
+ * assembled here and copied in one piece
+ **************************************************/
+void outConst(out_t *op, long n, uint8_t dataType) {
+    char buf[48];
+    register char *s;
+    char *sig;
+    unsigned long u;
+    size_t len;
+
+    if (dataType >= sizeof(basicSig) / sizeof(basicSig[0]))
+        dataType = 0;
+    sig = basicSig[dataType];
+    len = strlen(sig);
+    s   = buf + sizeof(buf) - len - 1;
+    memcpy(s, sig, len);
+    s[len] = '\n';
+    *--s   = ' ';
+    u      = n < 0 ? -(unsigned long)n : (unsigned long)n;
+    do {
+        *--s = (char)('0' + u % 10);
+    } while ((u /= 10));
+    if (n < 0)
+        *--s = '-';
+    *--s = ' ';
+    *--s = '>';
+    *--s = '-';
+    outWrite(op, s, buf + sizeof(buf) - s);
+}
+
+/**************************************************
+ * write the signature of a basic data type, with
+ * the leading ` when tick is set
+ **************************************************/
+void outBasicSig(out_t *op, uint8_t dataType, bool tick) {
+    if (dataType >= sizeof(basicSig) / sizeof(basicSig[0]))
+        dataType = 0;
+    outStr(op, basicSig[dataType] + !tick);
+}
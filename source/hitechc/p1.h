@@ -36,9 +36,11 @@
 #include "stdio.h"
 #include "tok.h"
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef __GNUC__
+#include <limits.h>
 #include <unistd.h>
 #define _MAX_PATH   PATH_MAX
 #endif
@@ -82,7 +84,19 @@ int putchar(int ch);
 #define blkclr(p, s) memset(p, 0, s);
 #endif
 
-#define HASHTABSIZE 271
+/* per translation unit state is thread local so -j can run units in
+ * parallel */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define TLS _Thread_local
+#else
+#define TLS
+#endif
+
+#define HASHTABINIT 256 /* initial buckets, must be a power of 2 */
+#define HASHLOAD    2   /* grow when symbols > buckets * HASHLOAD */
+#define CASECHUNK   255 /* most cases cgen3 takes in one [\ record */
+#define CASETABLE   8   /* fewest cases a dense switch range needs for a table */
+#define CASELEAF    16  /* most cases of a sparse switch compared in turn */
 
 /*
  *	Structural declarations
@@ -99,7 +113,7 @@ typedef struct _s8 {
     union {
         struct _sym *_nextSym;
         struct _s8 *_nextInfo;
-        int16_t _labelId;
+        int32_t _labelId;
     } u1;
     union {
         struct _sym *_pSym;
@@ -110,6 +124,7 @@ typedef struct _s8 {
     uint16_t i4;
     uint8_t dataType;
     char c7;
+    bool ro; /* the object itself is const */
 } s8_t;
 
 #define i_nextSym  u1._nextSym
@@ -125,14 +140,18 @@ typedef struct _sym {
     s8_t attr;
     struct _sym *m8;
     struct _sym *nMemberList;
-    int16_t nodeId;
+    int32_t nodeId;
     int16_t m14;
     int16_t m16;
     int16_t m18;
     uint8_t m20;
     char m21;
-    char nRefCnt;
     char *nVName;
+    uint32_t hash;            /* hashName(nVName), checked before strcmp */
+    struct _sym *scopeNext;   /* next symbol created at the same depth */
+    int32_t frameOff;         /* local kept in __frame, its offset + 1 */
+    uint32_t regUses;         /* uses weighted by loop depth, for regs.c */
+    int32_t order;            /* place in the original's hash chain */
 } sym_t;
 
 #define a_labelId  attr.i_labelId
@@ -167,6 +186,8 @@ typedef struct _s12 {
     bool uc9;
     bool uca;
     bool ucb;
+    bool star; /* the declarator has a '*' */
+    bool ro;   /* const just before the name */
 } s12_t;
 
 typedef struct _expr {
@@ -181,8 +202,8 @@ typedef struct _expr {
             struct _expr *_t_alt;
         } s1;
         struct {
-            int16_t _t_i0;
-            int16_t _t_i2;
+            int32_t _t_i0;
+            int32_t _t_i2;
 
         } s2;
     } u1;
@@ -200,14 +221,15 @@ typedef struct _expr {
 
 typedef struct {
     expr_t *caseVal;
-    int16_t caseLabel;
+    int32_t caseLabel;
 } s4_t;
 
 typedef struct {
     expr_t *switchExpr;
-    int16_t caseCnt;
-    int16_t defLabel;
-    s4_t caseOptions[255];
+    int32_t caseCnt;
+    int32_t defLabel;
+    int32_t caseMax;     /* slots in caseOptions */
+    s4_t *caseOptions;   /* was [255], grown in the current arena */
 } case_t;
 
 typedef struct {
@@ -215,66 +237,150 @@ typedef struct {
     uint8_t type2;
 } s2_t;
 
-extern s2_t *p2List;          /* 8bc7 */
-extern int16_t strId;         /* 8bd7 */
-extern uint8_t byte_8f85;     /* 8f85 */
-extern bool byte_8f86;        /* 8f86 */
-extern char *keywords[];      /* 8f87 */
-extern char *tmpFile;         /* 91db */
-extern t8_t opTable[68];      /* 9271 */
-extern uint8_t byte_968b;     /* 968b */
-extern int16_t word_968c;     /* 968c */
-extern int16_t tmpLabelId;    /* 968e */
-extern int16_t word_9caf;     /* 9caf */
-extern char ca9CB1[64];       /* 9cb1 */
-extern expr_t **s13SP;        /* 9cf1 */
-extern s2_t s2_9cf3[20];      /* 9cf3 */
-extern expr_t s13_9d1b;       /* 9d1b */
-extern expr_t s13_9d28;       /* 9d28 */
-extern expr_t *s13FreeList;   /* 9d35 */
-extern uint8_t byte_9d37;     /* 9d37 */
-extern expr_t *s13Stk[20];    /* 9d38 */
-extern char lastEmitSrc[64];  /* 9d60 */
-extern bool sInfoEmitted;     /* 9da0 */
-extern int16_t inCnt;         /* 9da1 */
-extern char lastEmitFunc[40]; /* 9da3 */
-extern YYTYPE yylval;         /* 9dcb */
-extern char nameBuf[32];      /* 9dcf */
-extern uint8_t ungetTok;      /* 9def */
-extern int16_t strChCnt;      /* 9df0 */
-extern bool lInfoEmitted;     /* 9df2 */
-extern int16_t startTokCnt;   /* 9df3 */
-extern int16_t ungetCh;       /* 9df5 */
-extern char errBuf[512];      /* 9df7 */
-extern FILE *crfFp;           /* 9ff7 */
-extern char crfNameBuf[30];   /* 9ff9 */
-extern char srcFile[100];     /* a017 */
-extern char *crfFile;         /* a07b */
-extern bool s_opt;            /* a07d */
-extern bool w_opt;            /* a07e */
-extern int16_t lineNo;        /* a07f */
-extern char *srcFileArg;      /* a081 */
-extern bool l_opt;            /* a083 */
-extern FILE *tmpFp;           /* a084 */
-extern char inBuf[512];       /* a086 */
-extern int16_t errCnt;        /* a286 */
-extern int8_t depth;         /* a288 */
-extern uint8_t byte_a289;     /* a289 */
-extern bool unreachable;      /* a28a */
-extern int16_t word_a28b;     /* a28b */
-extern sym_t *curFuncNode;    /* a28d */
-extern sym_t *p25_a28f;       /* ad8f */
-extern sym_t *word_a291;      /* as91 */
-extern sym_t *s25FreeList;    /* a293 */
-extern sym_t **hashtab;       /* a295 */
-extern s12_t *p12_a297;       /* a297 */
-extern uint8_t byte_a299;     /* a299 */
-extern uint8_t byte_a29a;     /* a29a */
+typedef struct _name {
+    struct _name *next;
+    uint32_t hash;
+    int16_t len;
+    uint8_t tok; /* keyword token, 0 for identifiers */
+    char s[1];   /* the characters, '\0' terminated */
+} name_t;
+/* header of an interned name */
+#define nameOf(p) ((name_t *)((p) - offsetof(name_t, s)))
+
+#define ARENAALIGN sizeof(long)
+
+typedef struct {
+    struct _block *blocks;
+    char *cur;
+    char *end;
+    size_t used;
+    size_t peak;
+    size_t reserved;
+} arena_t;
+
+typedef struct {
+    char *buf;
+    char *ptr;
+    char *end;
+    FILE *fp;
+    size_t total; /* bytes handed to fp, for -stats */
+} out_t;
+#define outCh(op, c) ((op)->ptr < (op)->end ? (void)(*(op)->ptr++ = (char)(c)) : outChSlow(op, c))
+
+/* -stats phases, the time of a unit is split between them */
+enum { PH_OTHER, PH_LEX, PH_DECL, PH_STMT, PH_EMIT, PH_COUNT };
+
+/* -stats allocation kinds */
+enum { AK_SYM, AK_EXPR, AK_ARGS, AK_STRING, AK_CASES, AK_NAME, AK_COUNT };
+
+typedef struct {
+    uint32_t cnt;    /* new allocations */
+    uint32_t shared; /* requests met by an existing copy */
+    size_t bytes;
+} allocStat_t;
+
+#define STATS_TEXT 1
+#define STATS_JSON 2
+#define statAlloc(kind, size) (allocStats[kind].cnt++, allocStats[kind].bytes += (size))
+
+extern TLS s2_t *p2List;          /* 8bc7 */
+extern TLS int32_t strId;         /* 8bd7 */
+extern TLS uint8_t byte_8f85;     /* 8f85 */
+extern TLS bool byte_8f86;        /* 8f86 */
+extern char *keywords[];          /* 8f87 */
+extern char *tmpFile;             /* 91db */
+extern t8_t opTable[68];          /* 9271 */
+extern TLS uint8_t byte_968b;     /* 968b */
+extern TLS int16_t word_968c;     /* 968c */
+extern TLS int32_t tmpLabelId;    /* 968e */
+extern TLS int32_t word_9caf;     /* 9caf */
+extern TLS int16_t lastSrcId;     /* 9cb1 was ca9CB1[64] */
+extern TLS expr_t **s13SP;        /* 9cf1 */
+extern TLS s2_t *s2_9cf3;         /* 9cf3 was [20], grows */
+extern TLS s2_t *s2End;           /* top of s2_9cf3, p2List starts here */
+extern TLS expr_t s13_9d1b;       /* 9d1b */
+extern TLS expr_t s13_9d28;       /* 9d28 */
+extern TLS uint8_t byte_9d37;     /* 9d37 */
+extern TLS expr_t **s13Stk;       /* 9d38 was [20], grows */
+extern TLS expr_t **s13End;       /* top of s13Stk, s13SP starts here */
+extern TLS int16_t lastErrSrcId;  /* 9d60 was lastEmitSrc[64] */
+extern TLS bool sInfoEmitted;     /* 9da0 */
+extern TLS int32_t inCnt;         /* 9da1 */
+extern TLS char lastEmitFunc[40]; /* 9da3 */
+extern TLS YYTYPE yylval;         /* 9dcb */
+extern TLS char nameBuf[32];      /* 9dcf */
+extern TLS char *lastName;
+extern TLS char *blank;
+extern TLS uint8_t ungetTok;    /* 9def */
+extern TLS bool tokConst;       /* const came before the last token */
+extern TLS int32_t strChCnt;    /* 9df0 */
+extern TLS bool lInfoEmitted;   /* 9df2 */
+extern TLS int32_t startTokCnt; /* 9df3 */
+extern TLS int16_t ungetCh;     /* 9df5 */
+extern char errBuf[512];        /* 9df7 */
+extern TLS FILE *crfFp;         /* 9ff7 */
+extern TLS char crfNameBuf[30]; /* 9ff9 */
+extern TLS char srcFile[100];   /* a017 */
+extern TLS int16_t srcId;       /* srcFileId(srcFile) */
+extern char *crfFile;           /* a07b */
+extern bool s_opt;              /* a07d */
+extern bool w_opt;              /* a07e */
+extern TLS int32_t lineNo;      /* a07f */
+extern TLS char *srcFileArg;    /* a081 */
+extern bool l_opt;              /* a083 */
+extern TLS char *inBuf;         /* a086 */
+extern TLS int16_t errCnt;      /* a286 */
+extern TLS int8_t depth;        /* a288 */
+extern TLS uint8_t byte_a289;   /* a289 */
+extern TLS bool unreachable;    /* a28a */
+extern TLS int32_t word_a28b;   /* a28b */
+extern TLS sym_t *curFuncNode;  /* a28d */
+extern TLS sym_t *p25_a28f;     /* ad8f */
+extern TLS bool dataPsect;      /* cgen3 is known to be in psect data */
+extern TLS sym_t **hashtab;     /* a295 */
+extern TLS uint32_t hashSize;   /* buckets in hashtab */
+extern bool h_opt;
+extern TLS s12_t *p12_a297;   /* a297 */
+extern TLS uint8_t byte_a299; /* a299 */
+extern TLS uint8_t byte_a29a; /* a29a */
+extern TLS arena_t tuArena;
+extern TLS arena_t bodyArena;
+extern TLS arena_t *curArena;
+extern bool a_opt;
+extern bool b_opt;
+extern int jobs;
+extern TLS FILE *errFp;
+extern TLS FILE *inFp;
+extern TLS out_t irOut;
+extern TLS out_t tmpOut;
+extern TLS bool pchMaking;
+extern char *depFile;
+extern TLS bool wantDeps;
+extern uint8_t statsOpt;
+extern TLS allocStat_t allocStats[AK_COUNT];
+
+/* arena.c */
+void *arenaAllocIn(register arena_t *ap, size_t size);
+void *arenaAlloc(size_t size);
+bool arenaOwns(arena_t *ap, void *p);
+void arenaWalk(arena_t *ap, void (*fn)(char *p, size_t len));
+void arenaReset(register arena_t *ap);
+void resetArenas(void);
+void prArenaStats(void);
+void arenaStats(void);
+
+/* deps.c */
+void depReset(void);
+void depAdd(char *name);
+void depScan(register char *s, char *end);
+void depList(FILE *fp);
+void depWrite(char *file);
 
 /* emit.c */
+void sub_013d(register out_t *p);
 void sub_01ec(register sym_t *p);
 void prFuncBrace(uint8_t tok);
-void emitLabelDef(int16_t p);
+void emitLabelDef(int32_t p);
 void sub_0273(register sym_t *st);
 void sub_02a6(case_t *p1);
 void sub_0353(sym_t *p, char c);
@@ -291,20 +397,51 @@ expr_t *sub_0a83(uint8_t n);
 expr_t *sub_0bfc(void);
 expr_t *sub_1441(uint8_t p1, register expr_t *lhs, expr_t *rhs);
 expr_t *sub_1b4b(long num, uint8_t p2);
+long normConst(long num, uint8_t dataType);
+long typeSize(register s8_t *st);
 bool sub_2105(register expr_t *st);
-bool s13ReleaseFreeList(void);
+bool isPureExpr(register expr_t *st);
 expr_t *sub_21c7(register expr_t *st);
 expr_t *allocId(register sym_t *st);
 expr_t *allocIConst(long p1);
 expr_t *allocSType(s8_t *p1);
 void pushS13(expr_t *p1);
-void sub_2569(register expr_t *st);
+/* expression trees are now released with their arena */
+#define sub_2569(st) ((void)(st))
 expr_t *sub_25f7(register expr_t *st);
+void resetExpr(void);
+
+/* frame.c */
+extern char *graphFile;
+extern char *frameFile;
+void frameLoad(char *file);
+void frameReset(void);
+void frameUnit(char *file);
+void frameEnter(register sym_t *st);
+void frameLeave(void);
+void frameLocal(register sym_t *st);
+void frameAsm(void);
+void frameCall(register expr_t *st);
+void frameAddr(register sym_t *st);
+expr_t *frameRef(register sym_t *st);
+void frameEnd(void);
+
+/* intern.c */
+uint32_t hashName(register char *s, int16_t len);
+char *intern(char *s, int16_t len);
+void initNames(void);
+int16_t srcFileId(char *name);
+char *srcFileName(int16_t id);
+void walkNames(void (*fn)(char *s));
 
 /* lex.c */
 uint8_t yylex(void);
 void prMsgAt(register char *buf);
 void emitSrcInfo(void);
+void resetLex(void);
+char *lineMarker(register char *s, char *end, size_t *len);
+char *lexInput(size_t *len);
+void resumeLex(size_t offset);
 int16_t peekCh(void);
 void skipStmt(uint8_t tok);
 void expect(uint8_t etok, char *msg);
@@ -321,31 +458,76 @@ void prError(char *fmt, ...);
 void fatalErr(char *fmt, ...);
 void prWarning(char *fmt, ...);
 #endif
+bool compileUnit(FILE *in, FILE *out);
+bool runStream(FILE *in, FILE *out);
 void expectErr(char *p);
 void *xalloc(size_t size);
 
+/* out.c */
+void outOpen(register out_t *op, FILE *fp);
+void outFlush(register out_t *op);
+void outDiscard(register out_t *op);
+void outChSlow(register out_t *op, int c);
+void outWrite(register out_t *op, char *s, size_t len);
+void outStr(out_t *op, char *s);
+void outNum(out_t *op, long n);
+void outConst(out_t *op, long n, uint8_t dataType);
+void outBasicSig(out_t *op, uint8_t dataType, bool tick);
+
+/* pch.c */
+void pchRoot(void *p, size_t size);
+void pchSnap(bool peeked);
+bool pchCreate(char *in, char *out);
+void pchRead(char *name);
+void pchLoad(void);
+
+/* server.c */
+void serve(char *sock);
+FILE *useServer(char *sock, int *status);
+
+/* stats.c */
+void statsReset(void);
+int statsPhase(int phase);
+void statsGroup(char *name);
+void statsNum(char *key, unsigned long n);
+void statsReal(char *key, double d);
+void prStats(void);
+
 /* program.c */
 void sub_3adf(void);
 void sub_3c7e(sym_t *p1);
 
+/* regs.c */
+extern TLS uint8_t loopDepth;
+void regEnter(void);
+void regVar(register sym_t *st);
+void regUse(register sym_t *st);
+void regAddr(register sym_t *st);
+void regAsm(void);
+void regLeave(void);
+
 /* stmt.c */
 void sub_409b(void);
+void sub_4d15(int32_t n, register expr_t *st, char c);
 
 /* sym.c */
 void sub_4d92(void);
+void prHashStats(void);
+void symStats(void);
+void pchSymRoots(void);
 sym_t *sub_4e90(register char *buf);
 sym_t *sub_4eed(register sym_t *st, uint8_t p2, s8_t *p3, sym_t *p4);
 void sub_516c(register sym_t *st);
 void sub_51cf(register sym_t *st);
 void sub_51e7(void);
-bool releaseNodeFreeList(void);
 void enterScope(void);
 void exitScope(void);
 void checkScopeExit(void);
+sym_t *promoteSym(register sym_t *st);
 sym_t *sub_56a4(void);
 sym_t *findMember(sym_t *p1, char *p2);
-void sub_573b(register sym_t *st, FILE *fp);
-int16_t newTmpLabel(void);
+void sub_573b(register sym_t *st, out_t *op);
+int32_t newTmpLabel(void);
 args_t *sub_578d(register args_t *p);
 void sub_58bd(register s8_t *st, s8_t *p2);
 bool sub_591d(register s8_t *st, s8_t *p2);
@@ -367,24 +549,6 @@ sym_t *sub_6360(void);
 sym_t *sub_69ca(uint8_t p1, register s8_t *p2, uint8_t p3, sym_t *p4);
 void sub_7454(register s8_t *st);
 
-#ifdef _WIN32
-void initMemAddr(void); /* for now only needed for windows */
-#else
-#define initMemAddr()
-#endif
-
-#ifdef CPM
-extern char _Hbss;
-#define inData(p) (((char *)p) < &_Hbss)
-#else
-#ifdef __APPLE__
-#include <malloc/malloc.h>
-#define initMemAddr()
-#define inData(p) (!malloc_zone_from_ptr(p))
-#else
-extern const char *_Ldata;
-extern const char *_Hbss;
-#define inData(p) (_Ldata <= ((const char *)p) && ((const char *)p) < _Hbss)
-#endif
-#endif
+/* the static integer constants 0 and 1, shared and never modified */
+#define isStaticExpr(p) ((p) == &s13_9d1b || (p) == &s13_9d28)
 #endif
@@ -0,0 +1,840 @@
+/*
+ * pch.c - precompiled headers for p1x3, written with -P and read with -U
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Precompiled headers.
+ * p1x3 -Pfile.pch header.i parses a unit that only includes headers and
+ * saves the state reached at its end: the tuArena nodes (symbols, struct
+ * tags, their s8_t types and args_t lists), the hash table, counters such
+ * as tmpLabelId and the IR the header produced. p1x3 -Ufile.pch starts
+ * each unit whose input begins with the same text from that state and the
+ * lexer carries on after it, so the output is that of a normal compile.
+ *
+ * Rather than describe every node layout, the header is parsed twice, side
+ * by side on two threads. A word that differs between the two must be a
+ * pointer to the same place in both, a node, a name or one of the static
+ * constants, and is relocated when the image is loaded. Any other
+ * difference, or an equal word that points into the program, and no image
+ * is written.
+ */
+#if !defined(CPM) && !defined(_WIN32)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define PCHMAGIC   "P1X3PCH"
+#define PCHVERSION 1
+#define MAXROOTS   64
+
+/* relocation kinds, in the top 4 bits */
+#define R_NODE     0 /* offset in the nodes */
+#define R_NAME     1 /* index of a name */
+#define R_STATIC   2 /* s13_9d1b or s13_9d28, then the offset */
+#define RELOC(k, v) ((uint32_t)(k) << 28 | (v))
+#define RKIND(r)    ((r) >> 28)
+#define RVAL(r)     ((r)&0xfffffff)
+
+#define ALIGN8(n)   (((n) + 7) & ~(size_t)7)
+
+typedef struct {
+    char magic[8];
+    uint32_t sig;      /* layout of the nodes and roots */
+    uint32_t relocCnt; /* where, what pairs */
+    uint32_t nodeLen;
+    uint32_t rootLen;
+    uint32_t hashCnt;
+    uint32_t nameCnt;
+    uint32_t namesLen;
+    uint32_t textLen; /* the header's input */
+    uint32_t irLen;
+    uint32_t tmpLen;
+    uint32_t mainName; /* names are given by index */
+    uint32_t argName;
+    uint32_t fileName; /* srcFile */
+    uint32_t idName[3]; /* srcId, lastSrcId, lastErrSrcId */
+} pchHdr_t;
+
+typedef struct {
+    void *p;
+    size_t size;
+} root_t;
+
+typedef struct {
+    char *p;
+    size_t len;
+} seg_t;
+
+typedef struct {
+    char *s;
+    uint32_t id;
+} nameRef_t;
+
+/* what one of the two parses left */
+typedef struct {
+    char *in;
+    bool quiet; /* messages are only counted */
+    char *why;  /* set if the state can't be saved */
+    seg_t *segs;
+    int segCnt;
+    size_t nodeLen;
+    nameRef_t *names; /* sorted by address */
+    uint32_t nameCnt;
+    char *roots;
+    size_t rootLen;
+    sym_t **hash;
+    uint32_t hashCnt;
+    char *statics[2];
+    char *ir;
+    size_t irLen;
+    char *tmp;
+    size_t tmpLen;
+    char *text;
+    size_t textLen;
+    char *refs[6]; /* the main, argument and srcFile names, then the ids */
+} snap_t;
+
+TLS bool pchMaking; /* this thread is parsing a header for -P */
+
+static TLS root_t roots[MAXROOTS];
+static TLS int rootCnt;
+static TLS snap_t *curSnap;
+static pthread_barrier_t pchBarrier;
+
+/* the image read for -U, shared by the -j threads */
+static pchHdr_t *hdr;
+static uint32_t *relocs;
+static char *nodes;
+static char *rootData;
+static char *hashData;
+static char **nameStr;
+static char *text;
+static char *irText;
+static char *tmpText;
+
+/**************************************************
+ * add a variable to the state kept in the image
+ **************************************************/
+void pchRoot(void *p, size_t size) {
+    if (rootCnt == MAXROOTS)
+        fatalErr("too many precompiled header roots");
+    roots[rootCnt].p      = p;
+    roots[rootCnt++].size = size;
+}
+
+/**************************************************
+ * list the variables that carry state from one
+ * declaration to the next. yylval and the
+ * expression stacks are left out as nothing reads
+ * them before they are set again, the file ids
+ * are mapped by name
+ **************************************************/
+static void findRoots(void) {
+    rootCnt = 0;
+    pchRoot(&strId, sizeof(strId));
+    pchRoot(&byte_8f85, sizeof(byte_8f85));
+    pchRoot(&byte_8f86, sizeof(byte_8f86));
+    pchRoot(&byte_968b, sizeof(byte_968b));
+    pchRoot(&word_968c, sizeof(word_968c));
+    pchRoot(&tmpLabelId, sizeof(tmpLabelId));
+    pchRoot(&byte_9d37, sizeof(byte_9d37));
+    pchRoot(&word_9caf, sizeof(word_9caf));
+    pchRoot(&sInfoEmitted, sizeof(sInfoEmitted));
+    pchRoot(&lInfoEmitted, sizeof(lInfoEmitted));
+    pchRoot(lastEmitFunc, sizeof(lastEmitFunc));
+    pchRoot(nameBuf, sizeof(nameBuf));
+    pchRoot(&lastName, sizeof(lastName));
+    pchRoot(&strChCnt, sizeof(strChCnt));
+    pchRoot(&lineNo, sizeof(lineNo));
+    pchRoot(&byte_a289, sizeof(byte_a289));
+    pchRoot(&unreachable, sizeof(unreachable));
+    pchRoot(&word_a28b, sizeof(word_a28b));
+    pchRoot(&curFuncNode, sizeof(curFuncNode));
+    pchRoot(&p25_a28f, sizeof(p25_a28f));
+    pchRoot(&dataPsect, sizeof(dataPsect));
+    pchRoot(&tokConst, sizeof(tokConst));
+    pchRoot(&hashSize, sizeof(hashSize));
+    pchRoot(&p12_a297, sizeof(p12_a297));
+    pchRoot(&byte_a299, sizeof(byte_a299));
+    pchRoot(&byte_a29a, sizeof(byte_a29a));
+    pchSymRoots();
+}
+
+/**************************************************
+ * bytes the roots take in the image, each is
+ * padded to a word
+ **************************************************/
+static size_t rootSize(void) {
+    size_t size;
+    int i;
+
+    for (size = 0, i = 0; i < rootCnt; i++)
+        size += ALIGN8(roots[i].size);
+    return size;
+}
+
+/**************************************************
+ * hash of everything the image layout depends on,
+ * an image from a different build is refused
+ **************************************************/
+static uint32_t layoutSig(void) {
+    uint32_t buf[MAXROOTS + 8];
+    int n;
+    int i;
+
+    n        = 0;
+    buf[n++] = PCHVERSION;
+    buf[n++] = sizeof(void *);
+    buf[n++] = sizeof(s8_t);
+    buf[n++] = sizeof(sym_t);
+    buf[n++] = sizeof(expr_t);
+    buf[n++] = sizeof(args_t);
+    buf[n++] = rootCnt;
+    for (i = 0; i < rootCnt; i++)
+        buf[n++] = (uint32_t)roots[i].size;
+    return hashName((char *)buf, (int16_t)(n * sizeof(buf[0])));
+}
+
+/* snapshot, run on each of the two threads */
+
+static void addSeg(char *p, size_t len) {
+    register snap_t *sp = curSnap;
+
+    if (!(sp->segCnt & 15) && !(sp->segs = realloc(sp->segs, (sp->segCnt + 16) * sizeof(seg_t))))
+        fatalErr("Out of memory");
+    sp->segs[sp->segCnt].p     = p;
+    sp->segs[sp->segCnt++].len = len;
+    sp->nodeLen += len;
+}
+
+static void addName(char *s) {
+    register snap_t *sp = curSnap;
+
+    if (!(sp->nameCnt & 1023) &&
+        !(sp->names = realloc(sp->names, (sp->nameCnt + 1024) * sizeof(nameRef_t))))
+        fatalErr("Out of memory");
+    sp->names[sp->nameCnt].s    = s;
+    sp->names[sp->nameCnt].id = sp->nameCnt;
+    sp->nameCnt++;
+}
+
+static int byAddr(const void *a, const void *b) {
+    char *sa = ((nameRef_t *)a)->s;
+    char *sb = ((nameRef_t *)b)->s;
+
+    return sa < sb ? -1 : sa > sb;
+}
+
+static char *copyOf(char *p, size_t len) {
+    char *s;
+
+    s = xalloc(len + 1);
+    memcpy(s, p, len);
+    return s;
+}
+
+/**************************************************
+ * called by sub_3abf at the end of the header, save
+ * the state before the end of unit checks change it.
+ * peeked is set if the parser read the end of the
+ * input as lookahead, a unit would see its own
+ * first token there
+ **************************************************/
+void pchSnap(bool peeked) {
+    register snap_t *sp = curSnap;
+    char *s;
+    size_t len;
+    int i;
+
+    if (peeked)
+        sp->why = "the header ends inside a declaration";
+    else if (errCnt)
+        sp->why = "errors in the header";
+    else if (depth || curArena != &tuArena || s13SP != s13End || p2List != s2End)
+        sp->why = "the header ends inside a function";
+    else if (irOut.fp || tmpOut.fp)
+        sp->why = "the header's output is too large";
+    if (sp->why)
+        return;
+
+    sp->text = lexInput(&sp->textLen);
+    if (!(s = lineMarker(sp->text, sp->text + sp->textLen, &len)) || len == 0) {
+        sp->why = "the input does not start with a line marker";
+        return;
+    }
+    /* all are already in the pool */
+    sp->refs[0] = intern(s, (int16_t)len);
+    sp->refs[1] = intern(srcFileArg, (int16_t)strlen(srcFileArg));
+    sp->refs[2] = intern(srcFile, (int16_t)strlen(srcFile));
+    sp->refs[3] = srcFileName(srcId);
+    sp->refs[4] = srcFileName(lastSrcId);
+    sp->refs[5] = srcFileName(lastErrSrcId);
+
+    arenaWalk(&tuArena, addSeg);
+    walkNames(addName);
+    qsort(sp->names, sp->nameCnt, sizeof(nameRef_t), byAddr);
+
+    findRoots();
+    sp->rootLen = rootSize();
+    sp->roots   = xalloc(sp->rootLen);
+    for (s = sp->roots, i = 0; i < rootCnt; s += ALIGN8(roots[i].size), i++)
+        memcpy(s, roots[i].p, roots[i].size);
+    sp->hashCnt    = hashSize;
+    sp->hash       = (sym_t **)copyOf((char *)hashtab, hashSize * sizeof(hashtab[0]));
+    sp->statics[0] = (char *)&s13_9d1b;
+    sp->statics[1] = (char *)&s13_9d28;
+    sp->ir         = copyOf(irOut.buf, sp->irLen = irOut.ptr - irOut.buf);
+    sp->tmp        = copyOf(tmpOut.buf, sp->tmpLen = tmpOut.ptr - tmpOut.buf);
+}
+
+/**************************************************
+ * -P worker, the first thread reports the header's
+ * messages, the second only notes there were any
+ **************************************************/
+static void *pchWorker(void *arg) {
+    snap_t *sp = arg;
+    FILE *fp;
+    char *msg;
+    size_t msgLen;
+
+    curSnap   = sp;
+    pchMaking = true;
+    msg       = NULL;
+    msgLen    = 0;
+    if (!sp->quiet || !(errFp = open_memstream(&msg, &msgLen)))
+        errFp = stderr;
+    initNames();
+    srcFileArg = sp->in;
+    strcpy(srcFile, srcFileArg);
+    if (!(fp = fopen(srcFileArg, "r")))
+        sp->why = "can't open the header";
+    else {
+        compileUnit(fp, NULL);
+        fclose(fp);
+    }
+    if (errFp != stderr) {
+        fclose(errFp);
+        if (msgLen && !sp->why)
+            sp->why = "messages from the header";
+        free(msg);
+    }
+    pthread_barrier_wait(&pchBarrier); /* both snapshots taken */
+    pthread_barrier_wait(&pchBarrier); /* compared while the threads exist */
+    return arg;
+}
+
+/* comparing the two parses, on the main thread */
+
+typedef struct {
+    uintptr_t lo;
+    uintptr_t hi;
+} range_t;
+
+static range_t *maps;
+static int mapCnt;
+
+/**************************************************
+ * note where the program and its main heap are, a
+ * pointer there is the same in both parses but
+ * would be wrong in another run. Other equal words
+ * may be padding left over from the stack
+ **************************************************/
+static bool readMaps(void) {
+    char line[512 + _MAX_PATH];
+    char exe[_MAX_PATH];
+    unsigned long lo;
+    unsigned long hi;
+    ssize_t n;
+    char *s;
+    FILE *fp;
+
+    if ((n = readlink("/proc/self/exe", exe, sizeof(exe) - 1)) < 0 || !(fp = fopen("/proc/self/maps", "r")))
+        return false;
+    exe[n] = '\0';
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%lx-%lx", &lo, &hi) != 2 || (!(s = strchr(line, '/')) && !(s = strchr(line, '['))))
+            continue;
+        s[strcspn(s, "\n")] = '\0';
+        if (strcmp(s, exe) == 0 || strcmp(s, "[heap]") == 0) {
+            if (!(mapCnt & 63) && !(maps = realloc(maps, (mapCnt + 64) * sizeof(range_t))))
+                fatalErr("Out of memory");
+            maps[mapCnt].lo   = lo;
+            maps[mapCnt++].hi = hi;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool mapped(uintptr_t v) {
+    int i;
+
+    for (i = 0; i < mapCnt; i++)
+        if (maps[i].lo <= v && v < maps[i].hi)
+            return true;
+    return false;
+}
+
+/**************************************************
+ * offset in the image nodes of the node byte at p,
+ * -1 if p is not in one
+ **************************************************/
+static long findNode(register snap_t *sp, uintptr_t p) {
+    long at;
+    int i;
+
+    for (at = 0, i = 0; i < sp->segCnt; at += (long)sp->segs[i++].len)
+        if ((uintptr_t)sp->segs[i].p <= p && p < (uintptr_t)sp->segs[i].p + sp->segs[i].len)
+            return at + (long)(p - (uintptr_t)sp->segs[i].p);
+    return -1;
+}
+
+/**************************************************
+ * number of the name at s, -1 if s is not a name
+ **************************************************/
+static long findName(register snap_t *sp, uintptr_t s) {
+    long lo;
+    long hi;
+    long mid;
+
+    for (lo = 0, hi = (long)sp->nameCnt - 1; lo <= hi;) {
+        mid = (lo + hi) / 2;
+        if ((uintptr_t)sp->names[mid].s == s)
+            return sp->names[mid].id;
+        if ((uintptr_t)sp->names[mid].s < s)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+/**************************************************
+ * compare a word from the two parses. 0 if it is
+ * plain data, 1 if it is a pointer and *what says
+ * where to, -1 if it can't be saved
+ **************************************************/
+static int classify(snap_t *a, snap_t *b, uintptr_t va, uintptr_t vb, uint32_t *what) {
+    long n;
+    int k;
+
+    if (va == vb)
+        return mapped(va) ? -1 : 0;
+    if ((n = findNode(a, va)) >= 0 && n == findNode(b, vb)) {
+        *what = RELOC(R_NODE, (uint32_t)n);
+        return 1;
+    }
+    if ((n = findName(a, va)) >= 0 && n == findName(b, vb)) {
+        *what = RELOC(R_NAME, (uint32_t)n);
+        return 1;
+    }
+    for (k = 0; k < 2; k++)
+        if (va - (uintptr_t)a->statics[k] < sizeof(expr_t) &&
+            vb - (uintptr_t)b->statics[k] == va - (uintptr_t)a->statics[k]) {
+            *what = RELOC(R_STATIC, k << 8 | (uint32_t)(va - (uintptr_t)a->statics[k]));
+            return 1;
+        }
+    return -1;
+}
+
+static TLS uint32_t *relocBuf;
+static TLS uint32_t relocCnt;
+
+/**************************************************
+ * compare len bytes of the two parses at pa and pb,
+ * which are at offset at in the image data. The
+ * pointers are noted and cleared in out
+ **************************************************/
+static bool relocate(snap_t *a, snap_t *b, char *pa, char *pb, size_t len, size_t at, char *out) {
+    uintptr_t va;
+    uintptr_t vb;
+    uint32_t what;
+    size_t i;
+
+    memcpy(out, pa, len);
+    for (i = 0; i + sizeof(va) <= len; i += sizeof(va)) {
+        memcpy(&va, pa + i, sizeof(va));
+        memcpy(&vb, pb + i, sizeof(vb));
+        switch (classify(a, b, va, vb, &what)) {
+        case -1:
+            return false;
+        case 1:
+            if (!(relocCnt & 1023) &&
+                !(relocBuf = realloc(relocBuf, (relocCnt + 1024) * 2 * sizeof(uint32_t))))
+                fatalErr("Out of memory");
+            relocBuf[relocCnt * 2]     = (uint32_t)(at + i);
+            relocBuf[relocCnt++ * 2 + 1] = what;
+            blkclr(out + i, sizeof(va));
+        }
+    }
+    return true;
+}
+
+/**************************************************
+ * true if the main file of the header's input has
+ * nothing but line markers and blank lines
+ **************************************************/
+static bool headerOnly(char *t, size_t len, char *main) {
+    char *end;
+    char *nl;
+    char *name;
+    size_t n;
+    bool inMain;
+
+    inMain = false;
+    for (end = t + len; t < end; t = nl + 1) {
+        if (!(nl = memchr(t, '\n', end - t)))
+            return false;
+        if ((name = lineMarker(t, nl, &n)))
+            inMain = n == strlen(main) && memcmp(name, main, n) == 0;
+        else if (inMain) {
+            while (t < nl && Isspace(*t))
+                t++;
+            if (t != nl)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void writeSec(FILE *fp, void *p, size_t len) {
+    static char zero[8];
+
+    if (p)
+        fwrite(p, 1, len, fp);
+    fwrite(zero, 1, ALIGN8(len) - len, fp);
+}
+
+/**************************************************
+ * compare the two parses and write the image
+ **************************************************/
+static bool makeImage(snap_t *a, snap_t *b, char *name) {
+    pchHdr_t h;
+    char *data;
+    char **order;
+    size_t at;
+    uint32_t i;
+    int k;
+    FILE *fp;
+
+    if (a->why || b->why)
+        fatalErr("no precompiled header written, %s", a->why ? a->why : b->why);
+    if (a->segCnt != b->segCnt || a->nodeLen != b->nodeLen || a->nameCnt != b->nameCnt ||
+        a->hashCnt != b->hashCnt || a->irLen != b->irLen || a->tmpLen != b->tmpLen)
+        fatalErr("no precompiled header written, the two parses differ");
+    for (k = 0; k < a->segCnt; k++)
+        if (a->segs[k].len != b->segs[k].len)
+            fatalErr("no precompiled header written, the two parses differ");
+    if (a->nodeLen >= 1 << 28 || a->nameCnt >= 1 << 28)
+        fatalErr("no precompiled header written, the header is too large");
+    if (!headerOnly(a->text, a->textLen, a->refs[0]))
+        fatalErr("no precompiled header written, %s must only include headers", a->in);
+    if (!readMaps())
+        fatalErr("no precompiled header written, can't read /proc/self/maps");
+
+    findRoots();
+    data = xalloc(a->nodeLen + a->rootLen + a->hashCnt * sizeof(sym_t *));
+    for (at = 0, k = 0; k < a->segCnt; at += a->segs[k++].len)
+        if (!relocate(a, b, a->segs[k].p, b->segs[k].p, a->segs[k].len, at, data + at))
+            fatalErr("no precompiled header written, a node can't be relocated");
+    if (!relocate(a, b, a->roots, b->roots, a->rootLen, at, data + at))
+        fatalErr("no precompiled header written, the parser state can't be relocated");
+    at += a->rootLen;
+    if (!relocate(a, b, (char *)a->hash, (char *)b->hash, a->hashCnt * sizeof(sym_t *), at, data + at))
+        fatalErr("no precompiled header written, the hash table can't be relocated");
+
+    blkclr(&h, sizeof(h));
+    memcpy(h.magic, PCHMAGIC, sizeof(h.magic));
+    h.sig      = layoutSig();
+    h.relocCnt = relocCnt;
+    h.nodeLen  = (uint32_t)a->nodeLen;
+    h.rootLen  = (uint32_t)a->rootLen;
+    h.hashCnt  = a->hashCnt;
+    h.nameCnt  = a->nameCnt;
+    h.textLen  = (uint32_t)a->textLen;
+    h.irLen    = (uint32_t)a->irLen;
+    h.tmpLen   = (uint32_t)a->tmpLen;
+    order      = xalloc(a->nameCnt * sizeof(char *));
+    for (i = 0; i < a->nameCnt; i++) {
+        order[a->names[i].id] = a->names[i].s;
+        h.namesLen += (uint32_t)strlen(a->names[i].s) + 1;
+    }
+    h.mainName  = (uint32_t)findName(a, (uintptr_t)a->refs[0]);
+    h.argName   = (uint32_t)findName(a, (uintptr_t)a->refs[1]);
+    h.fileName  = (uint32_t)findName(a, (uintptr_t)a->refs[2]);
+    for (k = 0; k < 3; k++)
+        h.idName[k] = (uint32_t)findName(a, (uintptr_t)a->refs[k + 3]);
+
+    if (!(fp = fopen(name, "wb")))
+        fatalErr("can't create %s", name);
+    writeSec(fp, &h, sizeof(h));
+    writeSec(fp, relocBuf, relocCnt * 2 * sizeof(uint32_t));
+    writeSec(fp, data, a->nodeLen);
+    writeSec(fp, data + a->nodeLen, a->rootLen);
+    writeSec(fp, data + a->nodeLen + a->rootLen, a->hashCnt * sizeof(sym_t *));
+    for (i = 0; i < a->nameCnt; i++)
+        fwrite(order[i], 1, strlen(order[i]) + 1, fp);
+    writeSec(fp, NULL, h.namesLen);
+    writeSec(fp, a->text, a->textLen);
+    writeSec(fp, a->ir, a->irLen);
+    writeSec(fp, a->tmp, a->tmpLen);
+    if (ferror(fp) | fclose(fp)) {
+        unlink(name);
+        fatalErr("can't write %s", name);
+    }
+    free(order);
+    free(data);
+    return true;
+}
+
+/**************************************************
+ * -P, parse the header in name on two threads and
+ * save its state to out
+ **************************************************/
+bool pchCreate(char *in, char *out) {
+    snap_t snaps[2];
+    pthread_t tids[2];
+    int i;
+    bool ok;
+
+    blkclr(snaps, sizeof(snaps));
+    snaps[0].in    = snaps[1].in = in;
+    snaps[1].quiet = true;
+    pthread_barrier_init(&pchBarrier, NULL, 3);
+    for (i = 0; i < 2; i++)
+        if (pthread_create(&tids[i], NULL, pchWorker, &snaps[i]) != 0)
+            fatalErr("can't start the threads for -P");
+    pthread_barrier_wait(&pchBarrier);
+    ok = makeImage(&snaps[0], &snaps[1], out);
+    pthread_barrier_wait(&pchBarrier);
+    for (i = 0; i < 2; i++)
+        pthread_join(tids[i], NULL);
+    return ok;
+}
+
+/* using an image */
+
+/**************************************************
+ * -U, read the image in one go and check it was
+ * made by this build
+ **************************************************/
+void pchRead(char *name) {
+    struct stat st;
+    char *p;
+    char *end;
+    uint32_t i;
+    int fd;
+
+    if ((fd = open(name, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+        fatalErr("can't open %s", name);
+    p = xalloc(st.st_size + 1);
+    if (read(fd, p, st.st_size) != st.st_size)
+        fatalErr("can't read %s", name);
+    close(fd);
+    end = p + st.st_size;
+    hdr = (pchHdr_t *)p;
+    findRoots();
+    if (st.st_size < (off_t)sizeof(pchHdr_t) || memcmp(hdr->magic, PCHMAGIC, sizeof(hdr->magic)) ||
+        hdr->sig != layoutSig() || hdr->rootLen != rootSize() ||
+        sizeof(pchHdr_t) + ALIGN8((size_t)hdr->relocCnt * 8) + ALIGN8(hdr->nodeLen) +
+                ALIGN8(hdr->rootLen) + ALIGN8((size_t)hdr->hashCnt * sizeof(sym_t *)) +
+                ALIGN8(hdr->namesLen) + ALIGN8(hdr->textLen) + ALIGN8(hdr->irLen) +
+                ALIGN8(hdr->tmpLen) !=
+            (size_t)st.st_size)
+        fatalErr("%s is not a precompiled header for this p1x3", name);
+    p += sizeof(pchHdr_t);
+    relocs = (uint32_t *)p;
+    p += ALIGN8((size_t)hdr->relocCnt * 8);
+    nodes = p;
+    p += ALIGN8(hdr->nodeLen);
+    rootData = p;
+    p += ALIGN8(hdr->rootLen);
+    hashData = p;
+    p += ALIGN8((size_t)hdr->hashCnt * sizeof(sym_t *));
+    nameStr = xalloc((hdr->nameCnt + 1) * sizeof(char *));
+    for (end = p + hdr->namesLen, i = 0; i < hdr->nameCnt && p < end; p += strlen(p) + 1)
+        nameStr[i++] = p;
+    p = end + (ALIGN8(hdr->namesLen) - hdr->namesLen);
+    text = p;
+    p += ALIGN8(hdr->textLen);
+    irText = p;
+    p += ALIGN8(hdr->irLen);
+    tmpText = p;
+    if (i != hdr->nameCnt || hdr->mainName >= i || hdr->argName >= i || hdr->fileName >= i ||
+        hdr->idName[0] >= i || hdr->idName[1] >= i || hdr->idName[2] >= i)
+        fatalErr("%s is corrupt", name);
+    for (i = 0; i < hdr->relocCnt; i++)
+        if (relocs[i * 2] + sizeof(char *) > hdr->nodeLen + hdr->rootLen + hdr->hashCnt * sizeof(sym_t *) ||
+            (RKIND(relocs[i * 2 + 1]) == R_NODE && RVAL(relocs[i * 2 + 1]) > hdr->nodeLen) ||
+            (RKIND(relocs[i * 2 + 1]) == R_NAME && RVAL(relocs[i * 2 + 1]) >= hdr->nameCnt) ||
+            RKIND(relocs[i * 2 + 1]) > R_STATIC)
+            fatalErr("%s is corrupt", name);
+}
+
+/**************************************************
+ * true if the input starts with the header's text,
+ * allowing for the main file's name in the line
+ * markers. *off is where the rest of the input
+ * starts, *uName and *uLen give the unit's name
+ **************************************************/
+static bool matchText(char *data, size_t len, size_t *off, char **uName, size_t *uLen) {
+    char *q;
+    char *t;
+    char *tEnd;
+    char *qEnd;
+    char *tn;
+    char *qn;
+    char *m;
+    char *u;
+    char *main;
+    size_t n;
+    size_t ql;
+
+    main   = nameStr[hdr->mainName];
+    *uName = NULL;
+    qEnd   = data + len;
+    tEnd   = text + hdr->textLen;
+    for (t = text, q = data; t < tEnd; t = tn + 1, q = qn + 1) {
+        tn = memchr(t, '\n', tEnd - t);
+        if (!(qn = memchr(q, '\n', qEnd - q)))
+            return false;
+        if ((m = lineMarker(t, tn, &n)) && n == strlen(main) && memcmp(m, main, n) == 0) {
+            if (!(u = lineMarker(q, qn, &ql)) || u - q != m - t || memcmp(t, q, m - t) != 0)
+                return false;
+            if (!*uName) {
+                *uName = u;
+                *uLen  = ql;
+            } else if (ql != *uLen || memcmp(u, *uName, ql) != 0)
+                return false;
+            if (tn - (m + n) != qn - (u + ql) || memcmp(m + n, u + ql, tn - (m + n)) != 0)
+                return false;
+        } else if (tn - t != qn - q || memcmp(t, q, tn - t) != 0)
+            return false;
+    }
+    *off = q - data;
+    return *uName != NULL;
+}
+
+/**************************************************
+ * the name a file id had in the header, in terms
+ * of this unit
+ **************************************************/
+static char *fileRef(uint32_t id, char *uName) {
+    if (id == hdr->mainName)
+        return uName;
+    if (id == hdr->argName)
+        return srcFileArg;
+    return nameStr[id];
+}
+
+/**************************************************
+ * called by compileUnit before parsing. If the unit
+ * starts with the header's text the parser starts
+ * from the saved state rather than read it again
+ **************************************************/
+void pchLoad(void) {
+    char uName[sizeof(srcFile)];
+    char **nameMap;
+    char *base;
+    char *rbuf;
+    char *hbuf;
+    char *data;
+    char *p;
+    char *v;
+    char *u;
+    size_t len;
+    size_t off;
+    size_t uLen FORCEINIT;
+    uint32_t where;
+    uint32_t what;
+    uint32_t i;
+    int k;
+
+    if (!hdr || s_opt || l_opt || crfFp)
+        return;
+    data = lexInput(&len);
+    if (!matchText(data, len, &off, &u, &uLen))
+        return;
+    if (uLen > sizeof(uName) - 1) /* as the lexer truncates it */
+        uLen = sizeof(uName) - 1;
+    memcpy(uName, u, uLen);
+    uName[uLen] = '\0';
+    if (wantDeps)
+        depScan(data, data + off);
+
+    nameMap = xalloc(hdr->nameCnt * sizeof(char *));
+    base    = arenaAllocIn(&tuArena, hdr->nodeLen);
+    memcpy(base, nodes, hdr->nodeLen);
+    rbuf = xalloc(hdr->rootLen);
+    memcpy(rbuf, rootData, hdr->rootLen);
+    hbuf = xalloc(hdr->hashCnt * sizeof(sym_t *));
+    memcpy(hbuf, hashData, hdr->hashCnt * sizeof(sym_t *));
+    for (i = 0; i < hdr->relocCnt; i++) {
+        where = relocs[i * 2];
+        what  = relocs[i * 2 + 1];
+        if (where < hdr->nodeLen)
+            p = base + where;
+        else if ((where -= hdr->nodeLen) < hdr->rootLen)
+            p = rbuf + where;
+        else
+            p = hbuf + where - hdr->rootLen;
+        switch (RKIND(what)) {
+        case R_NODE:
+            v = base + RVAL(what);
+            break;
+        case R_NAME:
+            if (!(v = nameMap[RVAL(what)]))
+                v = nameMap[RVAL(what)] = intern(nameStr[RVAL(what)], (int16_t)strlen(nameStr[RVAL(what)]));
+            break;
+        default:
+            v = (RVAL(what) >> 8 ? (char *)&s13_9d28 : (char *)&s13_9d1b) + (RVAL(what) & 0xff);
+            break;
+        }
+        memcpy(p, &v, sizeof(v));
+    }
+    findRoots();
+    for (p = rbuf, k = 0; k < rootCnt; p += ALIGN8(roots[k].size), k++)
+        memcpy(roots[k].p, p, roots[k].size);
+    free(rbuf);
+    free(nameMap);
+    free(hashtab);
+    hashtab = (sym_t **)hbuf;
+
+    strcpy(srcFile, fileRef(hdr->fileName, uName));
+    srcId        = srcFileId(fileRef(hdr->idName[0], uName));
+    lastSrcId    = srcFileId(fileRef(hdr->idName[1], uName));
+    lastErrSrcId = srcFileId(fileRef(hdr->idName[2], uName));
+    outWrite(&irOut, irText, hdr->irLen);
+    outWrite(&tmpOut, tmpText, hdr->tmpLen);
+    resumeLex(off);
+}
+
+#else
+/* precompiled headers need threads to be made */
+TLS bool pchMaking;
+
+void pchRoot(void *p, size_t size) {
+}
+
+void pchSnap(bool peeked) {
+}
+
+void pchLoad(void) {
+}
+#endif
@@ -31,14 +31,16 @@
  */
 #include "p1.h"
 
-int8_t depth;       /* a288 */
-uint8_t byte_a289;  /* a289 */
-bool unreachable;   /* a28a */
-int16_t word_a28b;  /* a28b */
-sym_t *curFuncNode; /* a28d */
-sym_t *p25_a28f;    /* ad8f */
+TLS int8_t depth;       /* a288 */
+TLS uint8_t byte_a289;  /* a289 */
+TLS bool unreachable;   /* a28a */
+TLS int32_t word_a28b;  /* a28b */
+TLS sym_t *curFuncNode; /* a28d */
+TLS sym_t *p25_a28f;    /* ad8f */
+TLS bool dataPsect;     /* cgen3 is known to be in psect data */
 
-int16_t sub_3d24(register sym_t *st, uint8_t p2);
+int32_t sub_3d24(register sym_t *st, uint8_t p2);
+static bool constElement(register sym_t *st);
 
 /**************************************************
  * 81: 3ADF +++
@@ -55,6 +57,7 @@ void sub_3adf(void) {
 
     register sym_t *st;
 
+    blkclr(&attr, sizeof(attr)); /* padding included, -P compares nodes word by word */
     scFlags = sub_5dd1(&scType, &attr);
     if ((tok = yylex()) == T_SEMI)
         return;
@@ -74,7 +77,9 @@ void sub_3adf(void) {
                 sub_516c(st);
                 sub_0493(st);
                 curFuncNode = st;
+                frameEnter(st);
                 sub_409b();
+                frameLeave();
                 return;
             }
             if (p25_a28f && !(p25_a28f->m18 & 8))
@@ -117,13 +122,28 @@ void sub_3adf(void) {
  * use of uint8_t param
  **************************************************/
 void sub_3c7e(sym_t *p1) {
-    int16_t var2;
+    int32_t var2;
+    bool rom;
     register sym_t *st;
 
     if (p1) {
-        printf("[i ");
-        sub_573b(p1, stdout);
-        putchar('\n');
+        /*
+         * const data goes in psect text, which is ROM in a ROM build.
+         * cgen3 puts every [i in psect data and only says so when it
+         * is not there already, so an empty string record takes it
+         * there first and the change to text is made behind its back.
+         * String 0 is never used, its label 09: is only a temporary
+         * one, so no string is renumbered. Not inside a function,
+         * where optim3 would take the data for part of the code
+         */
+        if ((rom = p1->attr.ro && depth == 0)) {
+            if (!dataPsect)
+                outStr(&irOut, "[a 0 ]\n");
+            outStr(&irOut, ";; psect text\n");
+        }
+        outStr(&irOut, "[i ");
+        sub_573b(p1, &irOut);
+        outCh(&irOut, '\n');
         st = p1;
         if ((var2 = sub_3d24(st, 1)) < 0) {
             prError("initialisation syntax");
@@ -132,7 +152,10 @@ void sub_3c7e(sym_t *p1) {
             sub_2569(st->a_expr);
             st->a_expr = allocIConst(var2);
         }
-        printf("]\n");
+        outStr(&irOut, "]\n");
+        if (rom)
+            outStr(&irOut, ";; psect data\n");
+        dataPsect = true;
     } else
         skipToSemi();
 }
@@ -142,8 +165,8 @@ void sub_3c7e(sym_t *p1) {
  * minor optimiser differences including moving basic
  * blocks. Use of uint8_t parameter
  **************************************************/
-int16_t sub_3d24(register sym_t *st, uint8_t p2) {
-    int16_t var2;
+int32_t sub_3d24(register sym_t *st, uint8_t p2) {
+    int32_t var2;
     uint8_t tok;
     char *var5;
     bool haveLbrace;
@@ -152,31 +175,24 @@ int16_t sub_3d24(register sym_t *st, uint8_t p2) {
     bool varb;
     expr_t *vard;
     bool vare;
+    bool flat;
 
-#ifdef CPM
-    /* manual string optimisation */
-    static char Ustr[] = ":U ..\n";
-    static char Dstr[] = "..\n";
-#else
-#define Ustr ":U ..\n"
-#define Dstr "..\n"
-#endif
 
     var2 = -1;
     if (p2 && st->a_c7 == ENODE && st->a_expr) {
-        printf(":U ..\n");
+        outStr(&irOut, ":U ..\n");
         if ((haveLbrace = ((tok = yylex()) == T_LBRACE)))
             tok = yylex();
         if (tok == T_SCONST && st->attr.i4 == 0 && (st->attr.dataType & ~1) == 4) {
             var2 = 0;
             var5 = yylval.yStr;
             while (var2 < strChCnt) {
-                printf("-> %d `c\n", *var5++);
+                outConst(&irOut, *var5++, DT_CHAR);
                 ++var2;
             }
             free(yylval.yStr);
             if (sub_2105(st->a_expr)) {
-                printf("-> %d `c\n", 0);
+                outConst(&irOut, 0, DT_CHAR);
                 ++var2;
             }
             if (haveLbrace)
@@ -190,8 +206,11 @@ int16_t sub_3d24(register sym_t *st, uint8_t p2) {
             else
                 p2 = 0;
             var2 = 0;
+            /* tables of plain integers skip the per element tree */
+            flat = p2 == 0 && st->a_c7 != ANODE && st->a_i4 == 0 &&
+                   st->a_dataType >= DT_CHAR && st->a_dataType <= DT_ULONG;
             for (;;) {
-                if (sub_3d24(st, p2) < 0)
+                if ((!flat || !constElement(st)) && sub_3d24(st, p2) < 0)
                     break;
                 var2++;
                 if ((tok = yylex()) == T_RBRACE || tok != T_COMMA || (tok = yylex()) == T_RBRACE)
@@ -204,12 +223,12 @@ int16_t sub_3d24(register sym_t *st, uint8_t p2) {
             expectErr("}");
             var2 = -1;
         }
-        printf(Dstr);
+        outStr(&irOut, "..\n");
     } else if ((p2 == 0 || st->a_c7 != ENODE) && st->a_i4 == 0 &&
                st->a_dataType == DT_STRUCT) { /* 3ec6 */
         if (p2)
-            printf(Ustr);
-        printf(Ustr);
+            outStr(&irOut, ":U ..\n");
+        outStr(&irOut, ":U ..\n");
         if ((var8 = st->a_nextSym)) {
             varb = (tok = yylex()) == T_LBRACE;
             if (!varb)
@@ -236,9 +255,9 @@ int16_t sub_3d24(register sym_t *st, uint8_t p2) {
             } else
                 var2 = 1;
         } /* 3fcd */
-        printf(Dstr);
+        outStr(&irOut, "..\n");
         if (p2)
-            printf(Dstr);
+            outStr(&irOut, "..\n");
 
     } else if ((p2 && st->attr.c7 == ENODE) || st->attr.c7 == ANODE ||
                (!(st->a_i4 & 1) && st->attr.dataType >= T_AUTO))
@@ -259,3 +278,23 @@ int16_t sub_3d24(register sym_t *st, uint8_t p2) {
     }
     return var2;
 }
+
+/**************************************************
+ * an element of a table of integers that is a lone
+ * constant, followed by , or }, is written straight
+ * out, as sub_3d24 would after building and folding
+ * the conversion tree. Anything else is left for
+ * sub_3d24 and false returned
+ **************************************************/
+static bool constElement(register sym_t *st) {
+    uint8_t tok;
+    int16_t ch;
+
+    if ((tok = yylex()) == T_ICONST && yylval.yNum >= 0 && ((ch = peekCh()) == ',' || ch == '}')) {
+        sub_013d(&irOut);
+        outConst(&irOut, yylval.yNum, st->a_dataType);
+        return true;
+    }
+    ungetTok = tok;
+    return false;
+}
@@ -0,0 +1,127 @@
+/*
+ * regs.c - automatic choice of a pointer register variable for p1x3
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Automatic register variables. cgen3 keeps one register variable of
+ * pointer type in iy, which csv saves, and leaves any other on the
+ * stack. When a function has none, the pointer local or parameter used
+ * the most is made register for it, each use counting 8 times for every
+ * loop around it. Locals whose address is taken, locals kept in __frame,
+ * which cgen3 is not told of, and functions with assembler in them are
+ * left alone.
+ *
+ * The [v records are written before the body is seen, so the place of
+ * each record's class letter in irOut is kept and the chosen one is
+ * changed to upper case when the body is done. A record already written
+ * out, in a function larger than the output buffer, is not changed.
+ */
+#define REGLOOPS 5 /* deeper loops weigh no more */
+#define REGMIN   3 /* fewer uses cost more than they save */
+
+typedef struct {
+    sym_t *st;
+    size_t at; /* the class letter, as an offset in the output */
+} regVar_t;
+
+TLS uint8_t loopDepth; /* loops around the current statement */
+
+static TLS regVar_t *regVars;
+static TLS int regCnt;
+static TLS int regMax;
+static TLS bool regBusy; /* iy has been asked for, or can't be used */
+static TLS bool regBody;
+
+/**************************************************
+ * the parameters and body of a function are next
+ **************************************************/
+void regEnter(void) {
+    regCnt    = 0;
+    regBusy   = false;
+    regBody   = true;
+    loopDepth = 0;
+}
+
+/**************************************************
+ * the [v record of st has just been written, note
+ * it if st could be given iy
+ **************************************************/
+void regVar(register sym_t *st) {
+
+    if (!regBody || (st->m20 != T_AUTO && st->m20 != D_6) || st->attr.c7 != SNODE ||
+        !(st->attr.i4 & 1))
+        return;
+    if (st->m18 & 4)
+        regBusy = true;
+    else if (!regBusy) {
+        if (regCnt == regMax &&
+            !(regVars = realloc(regVars, (regMax += 16) * sizeof(regVar_t))))
+            fatalErr("Out of memory");
+        st->regUses          = 0;
+        regVars[regCnt].st   = st;
+        regVars[regCnt++].at = irOut.total + (irOut.ptr - irOut.buf) - 1;
+    }
+}
+
+/**************************************************
+ * st is used
+ **************************************************/
+void regUse(register sym_t *st) {
+    uint32_t n;
+
+    n = (uint32_t)1 << 3 * (loopDepth < REGLOOPS ? loopDepth : REGLOOPS);
+    if ((st->regUses += n) < n)
+        st->regUses = ~(uint32_t)0;
+}
+
+/**************************************************
+ * the address of st is taken
+ **************************************************/
+void regAddr(register sym_t *st) {
+    st->m18 |= 0x800; /* never put in iy */
+}
+
+/**************************************************
+ * the function has assembler in it, which may use
+ * iy
+ **************************************************/
+void regAsm(void) {
+    regBusy = true;
+}
+
+/**************************************************
+ * the body is done, give iy to the best candidate
+ **************************************************/
+void regLeave(void) {
+    register regVar_t *best;
+    register regVar_t *rp;
+
+    best = NULL;
+    if (!regBusy)
+        for (rp = regVars; rp < regVars + regCnt; rp++)
+            if (!(rp->st->m18 & 0x800) && rp->st->regUses >= REGMIN &&
+                (!best || rp->st->regUses > best->st->regUses))
+                best = rp;
+    if (best && best->at >= irOut.total) {
+        irOut.buf[best->at - irOut.total] += 'A' - 'a';
+        best->st->m18 |= 4;
+    }
+    regCnt  = 0;
+    regBody = false;
+}
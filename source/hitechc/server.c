@@ -0,0 +1,325 @@
+/*
+ * server.c - the p1x3 compile server on a Unix domain socket
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+
+/*
+ * Compile server.
+ * p1x3 --server[=socket] listens on a Unix domain socket and compiles the
+ * units sent to it, so starting p1x3 and reading a -U precompiled header
+ * are done once rather than for every unit. With -j that many units are
+ * compiled at once. Each starts from the same clean state as a -batch
+ * unit and a fatal error only ends its own unit.
+ *
+ * When P1X3_SERVER names the socket an ordinary run of p1x3 is the
+ * client: it sends its input and copies back the IR, the messages and the
+ * exit status. If no server answers, or it is a different p1x3 or was
+ * started with other options, the unit is compiled as usual.
+ */
+#if !defined(CPM) && !defined(_WIN32)
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define SRVMAGIC   "P1S1"
+#define MAXWORKERS 256
+#define REFUSED    0xffffffff /* status for compile it yourself */
+
+typedef struct {
+    char magic[4];
+    uint32_t opts;    /* the options that change the output */
+    uint64_t exeDev;  /* which p1x3 the client is */
+    uint64_t exeIno;
+    int64_t exeTime;
+    uint32_t deps;    /* send back the files read, for -M */
+    uint32_t nameLen; /* srcFileArg, then the input */
+    uint32_t dataLen;
+} request_t;
+
+typedef struct {
+    uint32_t status;
+    uint32_t irLen; /* the IR, the messages, then the files read */
+    uint32_t msgLen;
+    uint32_t depLen;
+} reply_t;
+
+static int listenFd;
+static char *sockPath;
+static struct stat exeSt;
+
+static uint32_t options(void) {
+    return s_opt | w_opt << 1 | l_opt << 2 | h_opt << 3 | a_opt << 4 | statsOpt << 5;
+}
+
+static bool sendAll(int fd, void *p, size_t len) {
+    ssize_t n;
+
+    while (len) {
+        if ((n = send(fd, p, len, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p = (char *)p + n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool recvAll(int fd, void *p, size_t len) {
+    ssize_t n;
+
+    while (len) {
+        if ((n = recv(fd, p, len, 0)) < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p = (char *)p + n;
+        len -= n;
+    }
+    return true;
+}
+
+/**************************************************
+ * fill in the socket's address, false if the path
+ * is too long for one
+ **************************************************/
+static bool sockAddr(struct sockaddr_un *sa, char *path) {
+    if (strlen(path) >= sizeof(sa->sun_path))
+        return false;
+    blkclr(sa, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    strcpy(sa->sun_path, path);
+    return true;
+}
+
+/* an empty input can't be given to fmemopen */
+static FILE *memInput(char *data, size_t len) {
+    return len ? fmemopen(data, len, "r") : fopen("/dev/null", "r");
+}
+
+/**************************************************
+ * compile the unit sent on fd and send back the
+ * result
+ **************************************************/
+static void serveUnit(int fd) {
+    request_t rq;
+    reply_t rp;
+    char *name   = NULL;
+    char *data   = NULL;
+    char *ir     = NULL;
+    char *msg    = NULL;
+    char *dep    = NULL;
+    size_t irLen = 0;
+    size_t msgLen = 0;
+    size_t depLen = 0;
+    FILE *in;
+    FILE *out;
+    FILE *fp;
+
+    /* fatalErr can't be used outside runStream, the client is left to
+     * compile the unit itself instead */
+    if (!recvAll(fd, &rq, sizeof(rq)) || memcmp(rq.magic, SRVMAGIC, 4) ||
+        rq.nameLen >= sizeof(srcFile) || !(name = malloc(rq.nameLen + 1)) ||
+        !(data = malloc(rq.dataLen + 1)) || !recvAll(fd, name, rq.nameLen) ||
+        !recvAll(fd, data, rq.dataLen))
+        goto done;
+    name[rq.nameLen] = '\0';
+    blkclr(&rp, sizeof(rp));
+    if (rq.opts != options() || rq.exeDev != exeSt.st_dev || rq.exeIno != exeSt.st_ino ||
+        rq.exeTime != exeSt.st_mtime)
+        rp.status = REFUSED;
+    else if (!(in = memInput(data, rq.dataLen)))
+        rp.status = REFUSED;
+    else if (!(out = open_memstream(&ir, &irLen))) {
+        fclose(in);
+        rp.status = REFUSED;
+    } else if (!(errFp = open_memstream(&msg, &msgLen))) {
+        errFp = stderr;
+        fclose(in);
+        fclose(out);
+        rp.status = REFUSED;
+    } else {
+        srcFileArg = name;
+        strcpy(srcFile, name);
+        wantDeps   = rq.deps != 0;
+        rp.status  = !runStream(in, out);
+        fclose(in);
+        fclose(out);
+        fclose(errFp);
+        errFp = stderr;
+        if (wantDeps && (fp = open_memstream(&dep, &depLen))) {
+            depList(fp);
+            fclose(fp);
+        }
+        rp.irLen  = (uint32_t)irLen;
+        rp.msgLen = (uint32_t)msgLen;
+        rp.depLen = (uint32_t)depLen;
+    }
+    if (sendAll(fd, &rp, sizeof(rp)) && sendAll(fd, ir, irLen) && sendAll(fd, msg, msgLen))
+        sendAll(fd, dep, depLen);
+done:
+    free(ir);
+    free(msg);
+    free(dep);
+    free(data);
+    free(name);
+}
+
+static void *serveWorker(void *arg) {
+    int fd;
+
+    for (;;) {
+        if ((fd = accept(listenFd, NULL, NULL)) < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fprintf(stderr, "p1x3: accept failed: %s\n", strerror(errno));
+            sleep(1); /* out of fds, let the others finish */
+            continue;
+        }
+        serveUnit(fd);
+        close(fd);
+    }
+    return arg;
+}
+
+/**************************************************
+ * killed, remove the socket
+ **************************************************/
+static void onSignal(int sig) {
+    (void)sig;
+    unlink(sockPath);
+    _exit(0);
+}
+
+/**************************************************
+ * --server, listen on sock until killed
+ **************************************************/
+void serve(char *sock) {
+    struct sockaddr_un sa;
+    pthread_t tid;
+    int fd;
+    int n;
+
+    if (!sock || !*sock)
+        fatalErr("--server needs a socket, --server=path or P1X3_SERVER");
+    if (!sockAddr(&sa, sock))
+        fatalErr("socket path %s is too long", sock);
+    if (stat("/proc/self/exe", &exeSt) < 0)
+        fatalErr("can't find the p1x3 program");
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        fatalErr("can't create socket");
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0)
+        fatalErr("a server is already listening on %s", sock);
+    unlink(sock); /* left by one that was killed */
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, SOMAXCONN) < 0)
+        fatalErr("can't listen on %s", sock);
+    listenFd = fd;
+    sockPath = sock;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGHUP, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+    b_opt = true; /* fatal errors end the unit, not the server */
+    n     = jobs < MAXWORKERS ? jobs : MAXWORKERS;
+    while (--n > 0)
+        if (pthread_create(&tid, NULL, serveWorker, NULL) != 0)
+            break;
+    serveWorker(NULL);
+}
+
+/**************************************************
+ * send stdin to the server listening on sock. NULL
+ * if it compiled the unit, the IR is on stdout and
+ * *status is the exit status. Otherwise the stream
+ * to compile from here
+ **************************************************/
+FILE *useServer(char *sock, int *status) {
+    struct sockaddr_un sa;
+    struct stat st;
+    request_t rq;
+    reply_t rp;
+    char *data;
+    char *ir;
+    char *msg;
+    char *dep;
+    char *s;
+    char *nl;
+    size_t size;
+    size_t len;
+    size_t n;
+    int fd;
+    FILE *in;
+
+    if (!sockAddr(&sa, sock) || stat("/proc/self/exe", &st) < 0)
+        return stdin;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return stdin;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return stdin;
+    }
+    len  = 0;
+    size = 0x10000;
+    if (!(data = malloc(size)))
+        fatalErr("Out of memory");
+    while ((n = fread(data + len, 1, size - len, stdin)) > 0)
+        if ((len += n) == size && !(data = realloc(data, size *= 2)))
+            fatalErr("Out of memory");
+
+    blkclr(&rq, sizeof(rq));
+    memcpy(rq.magic, SRVMAGIC, 4);
+    rq.opts    = options();
+    rq.exeDev  = st.st_dev;
+    rq.exeIno  = st.st_ino;
+    rq.exeTime = st.st_mtime;
+    rq.deps    = wantDeps;
+    rq.nameLen = (uint32_t)strlen(srcFileArg);
+    rq.dataLen = (uint32_t)len;
+    ir = msg = dep = NULL;
+    if (len == rq.dataLen && sendAll(fd, &rq, sizeof(rq)) &&
+        sendAll(fd, srcFileArg, rq.nameLen) && sendAll(fd, data, len) &&
+        recvAll(fd, &rp, sizeof(rp)) && rp.status != REFUSED && (ir = malloc(rp.irLen + 1)) &&
+        (msg = malloc(rp.msgLen + 1)) && (dep = malloc(rp.depLen + 1)) &&
+        recvAll(fd, ir, rp.irLen) && recvAll(fd, msg, rp.msgLen) && recvAll(fd, dep, rp.depLen)) {
+        close(fd);
+        fwrite(ir, 1, rp.irLen, stdout);
+        fwrite(msg, 1, rp.msgLen, errFp);
+        for (s = dep; s < dep + rp.depLen; s = nl + 1) {
+            if (!(nl = memchr(s, '\n', dep + rp.depLen - s)))
+                break;
+            depAdd(intern(s, (int16_t)(nl - s)));
+        }
+        *status = rp.status;
+        free(ir);
+        free(msg);
+        free(dep);
+        free(data);
+        return NULL;
+    }
+    close(fd); /* do it here after all */
+    free(ir);
+    free(msg);
+    free(dep);
+    if (!(in = memInput(data, len)))
+        fatalErr("Out of memory");
+    return in;
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * stats.c - the p1x3 -stats report of compile phases and allocations
+ *
+ * The HI-TECH Z80 C cross compiler V3.09 is provided free of charge for any use,
+ * private or commercial, strictly as-is. No warranty or product support
+ * is offered or implied including merchantability, fitness for a particular
+ * purpose, or non-infringement. In no event will HI-TECH Software or its
+ * corporate affiliates be liable for any direct or indirect damages.
+ *
+ * You may use this software for whatever you like, providing you acknowledge
+ * that the copyright to this software remains with HI-TECH Software and its
+ * corporate affiliates.
+ *
+ * All copyrights to the algorithms used, binary code, trademarks, etc.
+ * belong to the legal owner - Microchip Technology Inc. and its subsidiaries.
+ * Commercial use and distribution of recreated source codes without permission
+ * from the copyright holderis strictly prohibited.
+ */
+#include "p1.h"
+#include <time.h>
+
+/*
+ * -stats, where the time of a unit goes and what it allocates.
+ * statsPhase charges the time since the previous switch to the phase
+ * being left, so a phase entered from another (the lexer called while
+ * parsing a declaration) is not counted twice. The report is written
+ * to errFp when the unit is done, as text or, with -stats=json, as one
+ * JSON object per unit on a line of its own.
+ *
+ * The original's free lists are gone, nodes come from the arenas and
+ * are never reused one at a time. What is reported for reuse instead
+ * is how often an argument list or a name was already there.
+ */
+uint8_t statsOpt; /* -stats, STATS_TEXT or STATS_JSON */
+TLS allocStat_t allocStats[AK_COUNT];
+
+static TLS uint64_t phaseNs[PH_COUNT];
+static TLS uint64_t lastNs;
+static TLS int curPhase;
+static TLS bool inGroup;
+static TLS bool firstKey;
+
+static char *phaseNames[PH_COUNT] = { "other", "lex", "declarations", "statements", "emit" };
+static char *allocNames[AK_COUNT] = { "symbols", "expressions", "arguments",
+                                      "strings", "cases",       "names" };
+
+/**************************************************
+ * a monotonic clock in nanoseconds
+ **************************************************/
+static uint64_t nowNs(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+/**************************************************
+ * start the figures for a new unit
+ **************************************************/
+void statsReset(void) {
+    blkclr(phaseNs, sizeof(phaseNs));
+    blkclr(allocStats, sizeof(allocStats));
+    curPhase = PH_OTHER;
+    lastNs   = nowNs();
+}
+
+/**************************************************
+ * switch to phase, returning the one left so the
+ * caller can go back to it
+ **************************************************/
+int statsPhase(int phase) {
+    uint64_t now;
+    int prev;
+
+    now = nowNs();
+    phaseNs[curPhase] += now - lastNs;
+    lastNs   = now;
+    prev     = curPhase;
+    curPhase = phase;
+    return prev;
+}
+
+/**************************************************
+ * begin a group of figures in the report
+ **************************************************/
+void statsGroup(char *name) {
+    if (statsOpt == STATS_JSON)
+        fprintf(errFp, "%s,\"%s\":{", inGroup ? "}" : "", name);
+    else
+        fprintf(errFp, "%s  %s:", inGroup ? "\n" : "", name);
+    inGroup  = true;
+    firstKey = true;
+}
+
+/**************************************************
+ * add a count to the current group
+ **************************************************/
+void statsNum(char *key, unsigned long n) {
+    if (statsOpt == STATS_JSON)
+        fprintf(errFp, "%s\"%s\":%lu", firstKey ? "" : ",", key, n);
+    else
+        fprintf(errFp, "%s %s %lu", firstKey ? "" : ",", key, n);
+    firstKey = false;
+}
+
+/**************************************************
+ * add a ratio or a time to the current group
+ **************************************************/
+void statsReal(char *key, double d) {
+    if (statsOpt == STATS_JSON)
+        fprintf(errFp, "%s\"%s\":%.3f", firstKey ? "" : ",", key, d);
+    else
+        fprintf(errFp, "%s %s %.3f", firstKey ? "" : ",", key, d);
+    firstKey = false;
+}
+
+/**************************************************
+ * write the report for the unit just compiled
+ **************************************************/
+void prStats(void) {
+    uint64_t total;
+    register char *s;
+    int i;
+
+    statsPhase(curPhase); /* charge the time up to now */
+    if (statsOpt == STATS_JSON) {
+        fputs("{\"unit\":\"", errFp);
+        for (s = srcFile; *s; s++) {
+            if (*s == '"' || *s == '\\')
+                fputc('\\', errFp);
+            fputc(*s, errFp);
+        }
+        fputc('"', errFp);
+    } else
+        fprintf(errFp, "stats: %s\n", srcFile);
+    inGroup = false;
+
+    statsGroup("time_ms");
+    total = 0;
+    for (i = 0; i < PH_COUNT; i++) {
+        statsReal(phaseNames[i], phaseNs[i] / 1e6);
+        total += phaseNs[i];
+    }
+    statsReal("total", total / 1e6);
+
+    symStats();
+    for (i = 0; i < AK_COUNT; i++) {
+        statsGroup(allocNames[i]);
+        statsNum("count", allocStats[i].cnt);
+        statsNum("bytes", (unsigned long)allocStats[i].bytes);
+        if (i == AK_ARGS || i == AK_NAME) {
+            statsNum("shared", allocStats[i].shared);
+            statsReal("reuse", allocStats[i].cnt + allocStats[i].shared
+                                   ? (double)allocStats[i].shared / (allocStats[i].cnt + allocStats[i].shared)
+                                   : 0.0);
+        }
+    }
+    arenaStats();
+
+    statsGroup("output");
+    statsNum("ir_bytes", (unsigned long)irOut.total);
+    fputs(statsOpt == STATS_JSON ? "}}\n" : "\n", errFp);
+}
@@ -31,23 +31,23 @@
  */
 #include "p1.h"
 
-void parseStmt(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4);
-void parseStmtGroup(int16_t p1, int16_t p2, case_t *p3, int16_t *p4);
+void parseStmt(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4);
+void parseStmtGroup(int32_t p1, int32_t p2, case_t *p3, int16_t *p4);
 void parseStmtAsm(void);
 void parseStmtWhile(case_t *p3);
 void parseStmtDo(case_t *p3);
-void parseStmtIf(int16_t p1, int16_t p2, case_t *p3, int16_t *p4);
-void parseStmtSwitch(int16_t p1);
+void parseStmtIf(int32_t p1, int32_t p2, case_t *p3, int16_t *p4);
+void parseStmtSwitch(int32_t p1);
 void parseStmtFor(case_t *p1);
-void parseStmtBreak_Continue(int16_t label);
-void parseStmtDefault(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4);
-void parseStmtCase(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4);
+void parseStmtBreak_Continue(int32_t label);
+void parseStmtDefault(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4);
+void parseStmtCase(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4);
 void parseStmtReturn(void);
 void parseStmtGoto(void);
-void parseStmtLabel(register sym_t *ps, int16_t p1, int16_t p2, case_t *p3, int16_t *p4);
+void parseStmtLabel(register sym_t *ps, int32_t p1, int32_t p2, case_t *p3, int16_t *p4);
 sym_t *sub_4ca4(register sym_t *ps);
-void sub_4ce8(int16_t n);
-void sub_4d15(int16_t n, register expr_t *st, char c);
+void sub_4ce8(int32_t n);
+void sub_4d15(int32_t n, register expr_t *st, char c);
 void sub_4d67(register expr_t *st);
 
 /**************************************************
@@ -56,7 +56,11 @@ void sub_4d67(register expr_t *st);
  **************************************************/
 void sub_409b(void) {
     uint8_t tok;
+    int phase = PH_OTHER;
 
+    if (statsOpt)
+        phase = statsPhase(PH_STMT);
+    regEnter();
     enterScope();
     sub_5c19(6);
     sub_51e7();
@@ -77,7 +81,10 @@ void sub_409b(void) {
     if (!unreachable && !byte_a289)
         prWarning("implicit return at end of non-void function");
     emitLabelDef(word_a28b);
+    regLeave();
     exitScope();
+    if (statsOpt)
+        statsPhase(phase);
 }
 
 /**************************************************
@@ -85,7 +92,7 @@ void sub_409b(void) {
  * trivial optimiser differences, use of uint8_t param
  * and addition of dummy parameters
  **************************************************/
-void parseStmt(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4) {
+void parseStmt(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4) {
     uint8_t tok;
     expr_t *var3;
 
@@ -163,7 +170,7 @@ void parseStmt(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4) {
  * 86: 4300 PMO +++
  * trivial optimiser differences and  use of uint8_t param
  **************************************************/
-void parseStmtGroup(int16_t p1, int16_t p2, case_t *p3, int16_t *p4) {
+void parseStmtGroup(int32_t p1, int32_t p2, case_t *p3, int16_t *p4) {
     bool haveDecl;
     uint8_t tok;
 
@@ -198,7 +205,11 @@ void parseStmtAsm(void) {
         expectErr("string");
         ungetTok = tok;
     } else {
-        printf(";; %s\n", yylval.yStr);
+        frameAsm();
+        regAsm();
+        outStr(&irOut, ";; ");
+        outStr(&irOut, yylval.yStr);
+        outCh(&irOut, '\n');
         free(yylval.yStr);
     }
 #ifdef BUGGY
@@ -218,9 +229,9 @@ void parseStmtAsm(void) {
  **************************************************/
 void parseStmtWhile(case_t *p3) {
     uint8_t tok;
-    int16_t continueLabel;
-    int16_t breakLabel;
-    int16_t loopLabel;
+    int32_t continueLabel;
+    int32_t breakLabel;
+    int32_t loopLabel;
     register expr_t *pe;
 
     if ((tok = yylex()) != T_LPAREN) {
@@ -229,12 +240,14 @@ void parseStmtWhile(case_t *p3) {
     }
     sub_4ce8(continueLabel = newTmpLabel());
     emitLabelDef(loopLabel = newTmpLabel());
+    loopDepth++;
     pe  = sub_0bfc();
     if ((tok = yylex()) != T_RPAREN) {
         expectErr(")");
         ungetTok = tok;
     }
     parseStmt(continueLabel, breakLabel = newTmpLabel(), p3, 0);
+    loopDepth--;
     emitLabelDef(continueLabel);
     sub_4d15(loopLabel, pe, 1);
     emitLabelDef(breakLabel);
@@ -247,14 +260,15 @@ void parseStmtWhile(case_t *p3) {
  **************************************************/
 void parseStmtDo(case_t *p3) {
     uint8_t tok;
-    int16_t continueLabel;
-    int16_t breakLabel;
-    int16_t loopLabel;
+    int32_t continueLabel;
+    int32_t breakLabel;
+    int32_t loopLabel;
     register expr_t *pe;
 
     continueLabel = newTmpLabel();
     breakLabel    = newTmpLabel();
     emitLabelDef(loopLabel = newTmpLabel());
+    loopDepth++;
     parseStmt(continueLabel, breakLabel, p3, 0);
     emitLabelDef(continueLabel);
     if ((tok = yylex()) != T_WHILE)
@@ -262,6 +276,7 @@ void parseStmtDo(case_t *p3) {
     if (tok == T_WHILE || tok == T_FOR)
         tok = yylex();
     else if (tok != T_LPAREN) {
+        loopDepth--;
         skipStmt(tok);
         return;
     }
@@ -270,6 +285,7 @@ void parseStmtDo(case_t *p3) {
         ungetTok = tok;
     }
     pe = sub_0bfc();
+    loopDepth--;
     expect(T_RPAREN, ")");
     sub_4d15(loopLabel, pe, 1);
     emitLabelDef(breakLabel);
@@ -282,10 +298,10 @@ void parseStmtDo(case_t *p3) {
  * 90: 4595 PMO +++
  * trivial optimiser differences and  use of uint8_t param
  **************************************************/
-void parseStmtIf(int16_t p1, int16_t p2, case_t *p3, int16_t *p4) {
+void parseStmtIf(int32_t p1, int32_t p2, case_t *p3, int16_t *p4) {
     uint8_t tok;
-    uint16_t endElseLabel;
-    uint16_t endIfLabel;
+    int32_t endElseLabel;
+    int32_t endIfLabel;
     uint8_t endifUnreachable;
     register expr_t *pe;
 
@@ -320,12 +336,12 @@ void parseStmtIf(int16_t p1, int16_t p2, case_t *p3, int16_t *p4) {
  * trivial optimiser differences, use of uint8_t param
  * and addition of dummy paramaters
  **************************************************/
-void parseStmtSwitch(int16_t p1) {
+void parseStmtSwitch(int32_t p1) {
     uint8_t tok;
-    int16_t endLabel;
-    int16_t var5;
+    int32_t endLabel;
+    int32_t var5;
     int16_t haveBreak;
-    int16_t cnt;
+    int32_t cnt;
     case_t caseInfo;
     register s8_t *ps;
 
@@ -334,8 +350,10 @@ void parseStmtSwitch(int16_t p1) {
         ungetTok = tok;
     }
     haveBreak         = 0;
-    caseInfo.defLabel = 0;
-    caseInfo.caseCnt  = 0;
+    caseInfo.defLabel    = 0;
+    caseInfo.caseCnt     = 0;
+    caseInfo.caseMax     = 0;
+    caseInfo.caseOptions = NULL;
     if ((caseInfo.switchExpr = sub_1441(T_60, sub_0bfc(), 0))) {
         ps = &caseInfo.switchExpr->attr;
         if (!sub_5a76(ps, DT_ENUM) && (!sub_5b08(ps) || ps->dataType >= DT_LONG))
@@ -372,10 +390,10 @@ void parseStmtSwitch(int16_t p1) {
  * and addition of dummy paramaters
  **************************************************/
 void parseStmtFor(case_t *p1) {
-    int16_t continueLabel;
-    int16_t breakLabel;
-    int16_t bodyLabel;
-    int16_t condLabel;
+    int32_t continueLabel;
+    int32_t breakLabel;
+    int32_t bodyLabel;
+    int32_t condLabel;
     int16_t haveCond;
     uint8_t tok;
     expr_t *condExpr;
@@ -394,6 +412,7 @@ void parseStmtFor(case_t *p1) {
         sub_2569(st);
         expect(T_SEMI, ";");
     }
+    loopDepth++; /* all but the first part is run each time round */
     if ((tok = yylex()) != T_SEMI) {
         haveCond = true;
         ungetTok = tok;
@@ -418,6 +437,7 @@ void parseStmtFor(case_t *p1) {
         sub_4ce8(condLabel = newTmpLabel());
     emitLabelDef(bodyLabel);
     parseStmt(continueLabel, breakLabel, p1, &haveCond);
+    loopDepth--;
     emitLabelDef(continueLabel);
     if (stepExpr) {
         sub_042d(stepExpr);
@@ -436,7 +456,7 @@ void parseStmtFor(case_t *p1) {
  * 93: 49E1 PMO +++
  * trivial optimiser differences
  **************************************************/
-void parseStmtBreak_Continue(int16_t label) {
+void parseStmtBreak_Continue(int32_t label) {
     uint8_t tok;
     if (label) {
         sub_4ce8(label);
@@ -450,7 +470,7 @@ void parseStmtBreak_Continue(int16_t label) {
 /**************************************************
  * 94: 4A1E PMO +++
  **************************************************/
-void parseStmtDefault(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4) {
+void parseStmtDefault(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4) {
     uint8_t tok;
 
     if ((tok = yylex()) != T_COLON)
@@ -466,15 +486,31 @@ void parseStmtDefault(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4)
     parseStmt(p1, p2, p3, p4);
 }
 
+/**************************************************
+ * double the room for case labels. The table comes
+ * from the current arena, which is the function
+ * body's, so the old one is simply left behind
+ **************************************************/
+static void growCases(register case_t *p) {
+    s4_t *cases;
+
+    p->caseMax = p->caseMax ? p->caseMax * 2 : 64;
+    cases      = arenaAlloc(p->caseMax * sizeof(s4_t));
+    statAlloc(AK_CASES, p->caseMax * sizeof(s4_t));
+    if (p->caseCnt > 1)
+        memcpy(cases, p->caseOptions, (p->caseCnt - 1) * sizeof(s4_t));
+    p->caseOptions = cases;
+}
+
 /**************************************************
  * 95: 4A90 PMO +++
  * trivial optimiser differences and  use of uint8_t param
  **************************************************/
-void parseStmtCase(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4) {
+void parseStmtCase(int32_t p1, int32_t p2, register case_t *p3, int16_t *p4) {
     uint8_t tok;
     expr_t *var3;
-    int16_t caseLabel;
-    int16_t caseIdx;
+    int32_t caseLabel;
+    int32_t caseIdx;
     s4_t *var9;
 
     var3 = sub_0a83(1);
@@ -484,8 +520,10 @@ void parseStmtCase(int16_t p1, int16_t p2, register case_t *p3, int16_t *p4) {
     }
     emitLabelDef(caseLabel = newTmpLabel());
     if (p3) {
-        if ((caseIdx = p3->caseCnt++) == 255)
-            fatalErr("Too many cases in switch");
+        if ((caseIdx = p3->caseCnt++) == CASECHUNK && !isPureExpr(p3->switchExpr))
+            fatalErr("Too many cases in switch"); /* it is evaluated once per CASECHUNK */
+        if (caseIdx == p3->caseMax)
+            growCases(p3);
         var9            = &p3->caseOptions[caseIdx];
         var9->caseLabel = caseLabel;
         if (var3 && p3->switchExpr) {
@@ -545,7 +583,7 @@ void parseStmtGoto(void) {
 /**************************************************
  * 98: 4C57 PMO +++
  **************************************************/
-void parseStmtLabel(register sym_t *ps, int16_t p1, int16_t p2, case_t *p3, int16_t *p4) {
+void parseStmtLabel(register sym_t *ps, int32_t p1, int32_t p2, case_t *p3, int16_t *p4) {
     ps = sub_4ca4(ps);
     if (ps) {
         emitLabelDef(ps->a_labelId);
@@ -577,7 +615,7 @@ sym_t *sub_4ca4(register sym_t *ps) {
  * differences due to dummy parameter and
  * use of uint8_t param
  **************************************************/
-void sub_4ce8(int16_t n) {
+void sub_4ce8(int32_t n) {
     register expr_t *st;
     st = sub_1441(T_122, allocIConst(n), 0);
     sub_042d(st);
@@ -589,7 +627,7 @@ void sub_4ce8(int16_t n) {
  * differences due to dummy parameter and
  * use of uint8_t param
  **************************************************/
-void sub_4d15(int16_t n, register expr_t *st, char c) {
+void sub_4d15(int32_t n, register expr_t *st, char c) {
 
     if (st) {
         if (c == 0)
@@ -31,59 +31,191 @@
  */
 #include "p1.h"
 
-sym_t *word_a291;   /* as91 */
-sym_t *s25FreeList; /* a293 */
-sym_t **hashtab;    /* a295 */
-s12_t *p12_a297;    /* a297 */
-uint8_t byte_a299;  /* a299 */
-uint8_t byte_a29a;  /* a29a */
-
-
+#define MEMBERINDEX 8 /* structs with this many members get an index */
+
+typedef struct {
+    sym_t *tag;    /* struct/union */
+    char *name;    /* interned member name, NULL marks the tag as indexed */
+    sym_t *member;
+} memberRef_t;
+
+typedef struct {
+    sym_t *st;
+    uint16_t chain; /* oldChain of its name */
+} exitRef_t;
+
+TLS sym_t **hashtab;   /* a295 */
+TLS s12_t *p12_a297;   /* a297 */
+TLS uint8_t byte_a299; /* a299 */
+TLS uint8_t byte_a29a; /* a29a */
+TLS uint32_t hashSize; /* buckets in hashtab, always a power of 2 */
+bool h_opt;            /* -H report hash chain statistics */
+
+static TLS sym_t *scopeHead[256]; /* symbols created per depth, in order */
+static TLS sym_t *scopeTail[256];
+static TLS exitRef_t *exitRefs; /* symbols checked at a scope exit */
+static TLS uint32_t exitMax;
+static TLS uint32_t symCnt; /* symbols linked into hashtab */
+static TLS uint32_t symPeak;
+static TLS uint32_t lookupCnt; /* statistics for -H */
+static TLS uint32_t probeCnt;
+static TLS uint16_t maxProbe;
+static TLS uint16_t growCnt;
+static TLS uint32_t scopeExits; /* statistics for -stats */
+static TLS uint32_t scopeSwept;
+static TLS int32_t nodeCnt; /* numbers the F labels */
+static TLS args_t **argTab;  /* canonical argument lists, open addressed */
+static TLS uint32_t argSize; /* slots in argTab, 0 or a power of 2 */
+static TLS uint32_t argCnt;
+static TLS memberRef_t *memberTab; /* open addressed, by tag and name */
+static TLS uint32_t memberSize;    /* slots in memberTab, 0 or a power of 2 */
+static TLS uint32_t memberCnt;
 
 sym_t **lookup(char *buf);
 sym_t *nodeAlloc(char *s);
-void reduceNodeRef(register sym_t *pn);
-void sub_583a(register args_t *st);
+static void linkScope(register sym_t *st);
 
 /**************************************************
  * 103: 4D92 PMO +++
+ * called again for each unit of -batch, so the
+ * table and counters are put back to their start
  **************************************************/
 void sub_4d92(void) {
 
-    s25FreeList = word_a291 = 0;
-    hashtab                 = xalloc(HASHTABSIZE * sizeof(hashtab[0]));
+    blkclr(scopeHead, sizeof(scopeHead));
+    blkclr(scopeTail, sizeof(scopeTail));
+    free(hashtab);
+    hashSize  = HASHTABINIT;
+    hashtab   = xalloc(hashSize * sizeof(hashtab[0]));
+    symCnt    = symPeak = lookupCnt = probeCnt = 0;
+    maxProbe  = growCnt = 0;
+    scopeExits = scopeSwept = 0;
+    nodeCnt   = 0;
+    free(argTab);
+    argTab    = NULL;
+    argSize   = argCnt = 0;
+    free(memberTab);
+    memberTab  = NULL;
+    memberSize = memberCnt = 0;
+    p12_a297  = NULL;
+    byte_a299 = byte_a29a = 0;
+}
+
+/**************************************************
+ * double the number of buckets, chains keep their
+ * relative order so shadowing symbols are still
+ * found before the ones they hide
+ **************************************************/
+static void growHashtab(void) {
+    sym_t **newTab;
+    sym_t **tails;
+    uint32_t newSize;
+    uint32_t i;
+    register sym_t *st;
+
+    newSize = hashSize * 2;
+    newTab  = xalloc(newSize * sizeof(newTab[0]));
+    tails   = xalloc(newSize * sizeof(tails[0]));
+    for (i = 0; i < hashSize; i++) {
+        while ((st = hashtab[i])) {
+            hashtab[i] = st->m8;
+            st->m8     = 0;
+            if (tails[st->hash & (newSize - 1)])
+                tails[st->hash & (newSize - 1)]->m8 = st;
+            else
+                newTab[st->hash & (newSize - 1)] = st;
+            tails[st->hash & (newSize - 1)] = st;
+        }
+    }
+    free(tails);
+    free(hashtab);
+    hashtab  = newTab;
+    hashSize = newSize;
+    growCnt++;
 }
 
 /**************************************************
  * 104: 4DA7 PMO +++
+ * hash table now grows with the symbol count, buf
+ * is an interned name so it is compared by pointer
  **************************************************/
 sym_t **lookup(char *buf) {
     sym_t **ps;
-    char *s;
-    uint16_t crc;
+    uint32_t hash;
+    uint16_t probes;
     uint8_t type;
     register sym_t *cp;
 
-    for (crc = 0, s = buf; *s; s++)
-        crc += crc + *(uint8_t *)s;
-    for (ps = &hashtab[crc % 271]; (cp = *ps); ps = &cp->m8) {
-        if (buf && strcmp(cp->nVName, buf) == 0) {
+    if (symCnt > hashSize * HASHLOAD)
+        growHashtab();
+    hash = nameOf(buf)->hash;
+    lookupCnt++;
+    probes = 0;
+    for (ps = &hashtab[hash & (hashSize - 1)]; (cp = *ps); ps = &cp->m8) {
+        probes++;
+        if (cp->nVName == buf) {
             if (((byte_8f85 == ((type = cp->m20) == D_STRUCT || type == D_UNION)) &&
                  byte_8f86 == (type == D_MEMBER)) ||
                 type == 0)
                 break;
         }
     }
+    probeCnt += probes;
+    if (probes > maxProbe)
+        maxProbe = probes;
     return ps;
 }
 
+/**************************************************
+ * report hash table statistics for -H
+ **************************************************/
+void prHashStats(void) {
+    uint32_t i;
+    uint32_t len;
+    uint32_t used;
+    uint32_t longest;
+    register sym_t *st;
+
+    for (used = longest = i = 0; i < hashSize; i++) {
+        for (len = 0, st = hashtab[i]; st; st = st->m8)
+            len++;
+        if (len)
+            used++;
+        if (len > longest)
+            longest = len;
+    }
+    fprintf(errFp, "hash: %lu buckets (%u resizes), %lu symbols (peak %lu), %lu chains used, "
+                    "longest %lu\n",
+            (unsigned long)hashSize, growCnt, (unsigned long)symCnt, (unsigned long)symPeak,
+            (unsigned long)used, (unsigned long)longest);
+    fprintf(errFp, "hash: %lu lookups, %.2f probes/lookup (max %u)\n", (unsigned long)lookupCnt,
+            lookupCnt ? (double)probeCnt / lookupCnt : 0.0, maxProbe);
+}
+
+/**************************************************
+ * the lookup and scope figures for -stats
+ **************************************************/
+void symStats(void) {
+    statsGroup("lookup");
+    statsNum("calls", lookupCnt);
+    statsReal("avg_chain", lookupCnt ? (double)probeCnt / lookupCnt : 0.0);
+    statsNum("max_chain", maxProbe);
+    statsGroup("scope");
+    statsNum("exits", scopeExits);
+    statsNum("swept", scopeSwept);
+}
+
 /**************************************************
  * 105: 4E90 PMO +++
  **************************************************/
 sym_t *sub_4e90(register char *buf) {
     sym_t **ps = lookup(buf);
-    if (*ps == 0)
-        *ps = nodeAlloc(buf);
+    if (*ps == 0) {
+        *ps          = nodeAlloc(buf);
+        (*ps)->order = (*ps)->nodeId; /* at the end of its chain */
+        if (++symCnt > symPeak)
+            symPeak = symCnt;
+    }
     if (crfFp && buf)
         fprintf(crfFp, "%s %d\n", buf, lineNo);
     return *ps;
@@ -108,7 +240,7 @@ sym_t *sub_4eed(register sym_t *st, uint8_t p2, s8_t *p3, sym_t *p4) {
                 if (p3->c7 == ANODE) {
                     if (p3->i_args && !st->attr.i_args)
                         var4 = "arguments";
-                    else if (p3->i_args) {
+                    else if (p3->i_args && p3->i_args != st->attr.i_args) {
                         if (p3->i_args->cnt != st->attr.i_args->cnt)
                             var4 = "no. of arguments";
                         else {
@@ -129,20 +261,18 @@ sym_t *sub_4eed(register sym_t *st, uint8_t p2, s8_t *p3, sym_t *p4) {
             else if (p3->c7 == ENODE && p3->i_expr && p3->i_expr != st->attr.i_expr) {
                 sub_2569(st->attr.i_expr);
                 st->attr.i_expr = p3->i_expr;
-            } else if (p3->c7 == ANODE) {
-                if (!st->attr.i_args)
-                    st->attr.i_args = p3->i_args;
-                else if (p3->i_args && p3->i_args != st->attr.i_args) {
-                    sub_583a(st->attr.i_args);
-                    st->attr.i_args = p3->i_args;
-                }
-            } /* 50d1 */
+            } else if (p3->c7 == ANODE && p3->i_args)
+                st->attr.i_args = p3->i_args;
+            /* 50d1 */
             return st;
         } /* 50d7 */
         ppSym        = lookup(st->nVName);
-        *ppSym       = nodeAlloc(st->nVName);
-        (*ppSym)->m8 = st;
-        st           = *ppSym;
+        *ppSym          = nodeAlloc(st->nVName);
+        (*ppSym)->m8    = st;
+        (*ppSym)->order = st->order; /* just before the one it hides */
+        st              = *ppSym;
+        if (++symCnt > symPeak)
+            symPeak = symCnt;
     } /* 5116 */
     switch (st->m20 = p2) {
     case DT_USHORT:
@@ -236,69 +366,41 @@ void sub_51e7(void) {
     var2 = 1;
 }
 
-/**************************************************
- * 110: 5356 PMO +++
- **************************************************/
-bool releaseNodeFreeList(void) {
-    register sym_t *st;
-
-    if (!s25FreeList)
-        return false;
-
-    while ((st = s25FreeList)) {
-        s25FreeList = st->nMemberList;
-        free(st);
-    }
-    return true;
-}
-
-char blank[] = "";
+TLS char *blank; /* interned "", the name of anonymous nodes */
 /**************************************************
  * 111: 5384 PMO +++
+ * nodes come from the current arena, there is no
+ * longer a free list or reference count
  **************************************************/
 sym_t *nodeAlloc(char *s) {
     register sym_t *pn;
-    static int16_t nodeCnt = 0;
 
-    if (s25FreeList) {
-        pn          = s25FreeList;
-        s25FreeList = pn->nMemberList;
-        blkclr(pn, sizeof(sym_t));
-    } else {
-        pn = xalloc(sizeof(sym_t));
-    }
-    pn->m21     = depth;
-    pn->nRefCnt = 1;
-    pn->nodeId  = ++nodeCnt;
+    pn         = arenaAlloc(sizeof(sym_t));
+    statAlloc(AK_SYM, sizeof(sym_t));
+    pn->m21    = depth;
+    pn->nodeId = ++nodeCnt;
+    linkScope(pn);
     if (s) {
-        pn->nVName = (char *)xalloc(strlen(s) + 1);
-        strcpy(pn->nVName, s);
-    } else
+        pn->nVName = s;
+        pn->hash   = nameOf(s)->hash;
+    } else {
         pn->nVName = blank;
+        pn->hash   = nameOf(blank)->hash;
+    }
     return pn;
 }
 
 /**************************************************
- * 112: 540C PMO +++
- * optimiser has better code for --pn->nRefCnt
+ * append a symbol to the list checked when the
+ * scope given by its m21 is exited
  **************************************************/
-void reduceNodeRef(register sym_t *pn) {
+static void linkScope(register sym_t *st) {
 
-    if (--pn->nRefCnt == 0) {
-        if (pn->m20 != 0 && pn->m20 != D_LABEL && pn->m20 != D_STRUCT && pn->m20 != D_UNION &&
-            pn->m20 != D_ENUM) {
-            if (pn->a_c7 == ANODE)
-                sub_583a(pn->a_args);
-            else if (pn->a_c7 == ENODE)
-                sub_2569(pn->a_expr);
-            if (pn->a_dataType == DT_POINTER)
-                reduceNodeRef(pn->a_nextSym);
-        }
-        if (pn->nVName != blank)
-            free(pn->nVName);
-        pn->nMemberList = s25FreeList;
-        s25FreeList     = pn;
-    }
+    if (scopeTail[(uint8_t)st->m21])
+        scopeTail[(uint8_t)st->m21]->scopeNext = st;
+    else
+        scopeHead[(uint8_t)st->m21] = st;
+    scopeTail[(uint8_t)st->m21] = st;
 }
 
 /**************************************************
@@ -308,6 +410,8 @@ void reduceNodeRef(register sym_t *pn) {
 void enterScope(void) {
 
     prFuncBrace(T_LBRACE);
+    if (depth == 0) /* function body */
+        curArena = &bodyArena;
     ++depth;
 }
 
@@ -318,94 +422,178 @@ void enterScope(void) {
 void exitScope(void) {
 
     checkScopeExit();
-    --depth;
+    if (--depth == 0) { /* nothing from the body is referenced any more */
+        curArena = &tuArena;
+        arenaReset(&bodyArena);
+    }
     prFuncBrace(T_RBRACE);
 }
 
+/**************************************************
+ * the chain the original's 271 bucket table gave
+ * name s
+ **************************************************/
+static uint16_t oldChain(register char *s) {
+    uint16_t crc;
+
+    for (crc = 0; *s; s++)
+        crc += crc + *(uint8_t *)s;
+    return crc % 271;
+}
+
+/**************************************************
+ * qsort order of exitRef_t, that of the original's
+ * hash chains
+ **************************************************/
+static int cmpExit(const void *p1, const void *p2) {
+    const exitRef_t *a = p1;
+    const exitRef_t *b = p2;
+
+    if (a->chain != b->chain)
+        return a->chain < b->chain ? -1 : 1;
+    if (a->st->order != b->st->order)
+        return a->st->order < b->st->order ? -1 : 1;
+    return a->st->nodeId > b->st->nodeId ? -1 : a->st->nodeId < b->st->nodeId;
+}
+
+/**************************************************
+ * report st as undefined or unused if it is
+ **************************************************/
+static void reportExit(register sym_t *st) {
+    uint8_t var5;
+    char *var7;
+
+    var7 = 0;
+    var5 = st->m20;
+    if ((st->m18 & 3) == 2) {
+        switch (var5) {
+        case D_LABEL:
+            var7 = "label";
+            break;
+        case D_STRUCT:
+        case D_UNION:
+        case T_EXTERN:
+            break;
+        default:
+            var7 = "variable";
+            break;
+        }
+        if (var7)
+            prError("undefined %s: %s", var7, st->nVName);
+    } else if ((depth || var5 == T_STATIC) && !(st->m18 & 2)) { /* 5555  */
+        switch (var5) {
+        case D_LABEL:
+            var7 = "label";
+            break;
+        case D_STRUCT:
+            var7 = "structure";
+            break;
+        case D_UNION:
+            var7 = "union";
+            break;
+        case D_MEMBER:
+            var7 = "member";
+            break;
+        case D_ENUM:
+            var7 = "enum";
+            break;
+        case D_CONST:
+            var7 = "constant";
+            break;
+        case T_TYPEDEF:
+            var7 = "typedef";
+            break;
+        case D_6:
+            var7 = 0;
+            break;
+        default:
+            if (var5) {
+                if (st->m18 & 1)
+                    var7 = "variable definition";
+                else
+                    var7 = "variable declaration";
+            }
+            break;
+        }
+        if (var7)
+            prWarning("unused %s: %s", var7, st->nVName);
+    } /* 55d2 */
+}
+
 /**************************************************
  * 115: 54C0 PMO +++
+ * only the symbols created at this depth are visited.
+ * Those that may be reported are sorted into the
+ * order the original's hash table walk gave them
  **************************************************/
 void checkScopeExit(void) {
     sym_t **ppSym;
-    sym_t **var4;
-    uint8_t var5;
-    char *var7;
+    sym_t *next;
+    uint32_t cnt;
+    uint32_t i;
     register sym_t *st;
 
-    for (ppSym = hashtab; ppSym < &hashtab[HASHTABSIZE]; ppSym++) {
-        var4 = ppSym;
-        while ((st = *var4)) {
-            if (st->m21 == depth) {
-                var7 = 0;
-                var5 = st->m20;
-                if ((st->m18 & 3) == 2) {
-                    switch (var5) {
-                    case D_LABEL:
-                        var7 = "label";
-                        break;
-                    case D_STRUCT:
-                    case D_UNION:
-                    case T_EXTERN:
-                        break;
-                    default:
-                        var7 = "variable";
-                        break;
-                    }
-                    if (var7)
-                        prError("undefined %s: %s", var7, st->nVName);
-                } else if ((depth || var5 == T_STATIC) && !(st->m18 & 2)) { /* 5555  */
-                    switch (var5) {
-                    case D_LABEL:
-                        var7 = "label";
-                        break;
-                    case D_STRUCT:
-                        var7 = "structure";
-                        break;
-                    case D_UNION:
-                        var7 = "union";
-                        break;
-                    case D_MEMBER:
-                        var7 = "member";
-                        break;
-                    case D_ENUM:
-                        var7 = "enum";
-                        break;
-                    case D_CONST:
-                        var7 = "constant";
-                        break;
-                    case T_TYPEDEF:
-                        var7 = "typedef";
-                        break;
-                    case D_6:
-                        var7 = 0;
-                        break;
-                    default:
-                        if (var5) {
-                            if (st->m18 & 1)
-                                var7 = "variable definition";
-                            else
-                                var7 = "variable declaration";
-                        }
-                        break;
-                    }
-                    if (var7)
-                        prWarning("unused %s: %s", var7, st->nVName);
-
-                } /* 55d2 */
-                *var4 = st->m8;
-                reduceNodeRef(st);
-            } else
-                var4 = &st->m8;
+    st                        = scopeHead[(uint8_t)depth];
+    scopeHead[(uint8_t)depth] = scopeTail[(uint8_t)depth] = 0;
+    scopeExits++;
+    cnt = 0;
+    for (; st; st = next) {
+        scopeSwept++;
+        next          = st->scopeNext;
+        st->scopeNext = 0;
+        if (st->m21 != depth) /* scope changed since creation */
+            linkScope(st);
+        else if (st->nVName != blank) { /* anonymous nodes are not in hashtab */
+            if ((st->m18 & 3) == 2 || ((depth || st->m20 == T_STATIC) && !(st->m18 & 2))) {
+                if (cnt == exitMax &&
+                    !(exitRefs = realloc(exitRefs, (exitMax += 64) * sizeof(exitRef_t))))
+                    fatalErr("Out of memory");
+                exitRefs[cnt].st      = st;
+                exitRefs[cnt++].chain = oldChain(st->nVName);
+            }
+            for (ppSym = &hashtab[st->hash & (hashSize - 1)]; *ppSym != st;
+                 ppSym = &(*ppSym)->m8)
+                ;
+            *ppSym = st->m8;
+            symCnt--;
         }
     }
-    var4 = &word_a291;
-    while ((st = *var4)) {
-        if (st->m21 == depth) {
-            *var4 = st->m8;
-            reduceNodeRef(st);
-        } else
-            var4 = &st->m8;
+    if (cnt > 1)
+        qsort(exitRefs, cnt, sizeof(exitRef_t), cmpExit);
+    for (i = 0; i < cnt; i++)
+        reportExit(exitRefs[i].st);
+}
+
+/**************************************************
+ * move a symbol created inside a function body to
+ * tuArena so that it can outlive the body, used for
+ * implicitly declared functions which become global
+ **************************************************/
+sym_t *promoteSym(register sym_t *st) {
+    sym_t **ppSym;
+    sym_t *prev;
+    sym_t *pn;
+
+    if (!arenaOwns(&bodyArena, st))
+        return st;
+    pn  = arenaAllocIn(&tuArena, sizeof(sym_t));
+    statAlloc(AK_SYM, sizeof(sym_t));
+    *pn = *st;
+    for (ppSym = &hashtab[st->hash & (hashSize - 1)]; *ppSym; ppSym = &(*ppSym)->m8)
+        if (*ppSym == st) {
+            *ppSym = pn;
+            break;
+        }
+    if (scopeHead[(uint8_t)st->m21] == st)
+        scopeHead[(uint8_t)st->m21] = pn;
+    else {
+        for (prev = scopeHead[(uint8_t)st->m21]; prev->scopeNext != st; prev = prev->scopeNext)
+            ;
+        prev->scopeNext = pn;
     }
+    if (scopeTail[(uint8_t)st->m21] == st)
+        scopeTail[(uint8_t)st->m21] = pn;
+    return pn;
 }
 
 /**************************************************
@@ -416,85 +604,213 @@ sym_t *sub_56a4(void) {
 
     st = nodeAlloc(0);
     st->m18 |= 0x83;
-    st->m8    = word_a291;
-    word_a291 = st;
     return st;
 }
 
+/**************************************************
+ * hash of a tag and member name pair
+ **************************************************/
+static uint32_t hashMember(sym_t *tag, char *name) {
+    return ((uint32_t)((uintptr_t)tag >> 3) * 16777619u) ^ (name ? nameOf(name)->hash : 0);
+}
+
+/**************************************************
+ * the memberTab slot for tag and name, or the empty
+ * slot where it would go
+ **************************************************/
+static memberRef_t *memberSlot(sym_t *tag, char *name) {
+    uint32_t i;
+    register memberRef_t *mp;
+
+    for (i = hashMember(tag, name) & (memberSize - 1);; i = (i + 1) & (memberSize - 1))
+        if (!(mp = &memberTab[i])->tag || (mp->tag == tag && mp->name == name))
+            return mp;
+}
+
+/**************************************************
+ * add tag and name to memberTab, the first of
+ * duplicate member names is kept, as the list
+ * walk would find it
+ **************************************************/
+static void addMember(sym_t *tag, char *name, sym_t *member) {
+    memberRef_t *oldTab;
+    uint32_t oldSize;
+    uint32_t i;
+    register memberRef_t *mp;
+
+    if (memberCnt >= memberSize / 2) {
+        oldTab     = memberTab;
+        oldSize    = memberSize;
+        memberSize = oldSize ? oldSize * 2 : HASHTABINIT;
+        memberTab  = xalloc(memberSize * sizeof(memberTab[0]));
+        for (i = 0; i < oldSize; i++)
+            if (oldTab[i].tag)
+                *memberSlot(oldTab[i].tag, oldTab[i].name) = oldTab[i];
+        free(oldTab);
+    }
+    if (!(mp = memberSlot(tag, name))->tag) {
+        mp->tag    = tag;
+        mp->name   = name;
+        mp->member = member;
+        memberCnt++;
+    }
+}
+
+/**************************************************
+ * enter all the members of tag in memberTab
+ **************************************************/
+static void indexMembers(sym_t *tag) {
+    register sym_t *st;
+
+    for (st = tag->nMemberList; st != tag; st = st->nMemberList)
+        addMember(tag, st->nVName, st);
+    addMember(tag, NULL, NULL);
+}
+
 /**************************************************
  * 117: 56CD PMO +++
+ * the members of a large struct/union are entered
+ * in memberTab the first time the list walk gets
+ * long. Tags local to a function body are left
+ * out, their nodes go when the body is exited
  **************************************************/
 sym_t *findMember(sym_t *p1, char *p2) {
     register sym_t *st;
-
-    st = p1->nMemberList;
-    for (;;) {
-        if (p1 == st) {
-            prError("%s is not a member of the struct/union %s", p2, p1->nVName);
-            return NULL;
-        }
-        if (strcmp(st->nVName, p2) == 0)
-            return st;
-        st = st->nMemberList;
+    memberRef_t *mp;
+    int16_t cnt;
+
+    if (memberSize && (mp = memberSlot(p1, p2))->tag)
+        return mp->member;
+    if (memberSize && memberSlot(p1, NULL)->tag)
+        st = p1; /* indexed, so not a member */
+    else {
+        for (cnt = 0, st = p1->nMemberList; st != p1 && st->nVName != p2; st = st->nMemberList)
+            cnt++; /* names are both interned */
+        if (cnt >= MEMBERINDEX && !arenaOwns(&bodyArena, p1))
+            indexMembers(p1);
     }
+    if (p1 == st) {
+        prError("%s is not a member of the struct/union %s", p2, p1->nVName);
+        return NULL;
+    }
+    return st;
 }
 
 /**************************************************
  * 118: 573B PMO +++
  **************************************************/
-void sub_573b(register sym_t *st, FILE *fp) {
+void sub_573b(register sym_t *st, out_t *op) {
 
     if (st) {
-        if (st->m18 & 0x80)
-            fprintf(fp, "F%d", st->nodeId);
-        else
-            fprintf(fp, "_%s", st->nVName);
+        if (st->m18 & 0x80) {
+            outCh(op, 'F');
+            outNum(op, st->nodeId);
+        } else {
+            outCh(op, '_');
+            outWrite(op, st->nVName, nameOf(st->nVName)->len);
+        }
     }
 }
 
 /**************************************************
  * 119: 5785 PMO +++
  **************************************************/
-int16_t newTmpLabel(void) {
+int32_t newTmpLabel(void) {
 
     return ++tmpLabelId;
 }
 
 /**************************************************
- * 120: 578D PMO +++
- * trivial optimiser differences
+ * FNV-1a hash of the descriptors in an argument
+ * list, pointers are taken by value
  **************************************************/
-args_t *sub_578d(register args_t *p) {
-    args_t *var2;
-    s8_t *var4;
-    int16_t var6;
-    if (!p)
-        return p;
-    var2 = xalloc(sizeof(args_t) + (p->cnt - 1) * sizeof(s8_t));
-    var6 = var2->cnt = p->cnt;
-    while (var6--) {
-        var4  = &var2->s8array[var6];
-        *var4 = p->s8array[var6];
-        if (var4->dataType == DT_POINTER)
-            var4->i_nextSym->nRefCnt++;
+static uint32_t hashArgs(register args_t *p) {
+    uint32_t h;
+    int16_t i;
+    s8_t *sp;
+
+    h = (2166136261u ^ (uint16_t)p->cnt) * 16777619u;
+    for (i = 0; i < p->cnt; i++) {
+        sp = &p->s8array[i];
+        h  = (h ^ (uint32_t)((uintptr_t)sp->i_nextSym >> 3)) * 16777619u;
+        h  = (h ^ (uint32_t)((uintptr_t)sp->i_sym >> 3)) * 16777619u;
+        h  = (h ^ (sp->i4 << 16 | sp->dataType << 8 | (uint8_t)sp->c7)) * 16777619u;
+        h  = (h ^ sp->ro) * 16777619u;
     }
-    return var2;
+    return h;
 }
 
 /**************************************************
- * 121: 583A PMO +++
+ * true if the two lists hold identical descriptors
  **************************************************/
-void sub_583a(register args_t *st) {
-    s8_t *var2;
-    if (st) {
-        for (var2 = st->s8array; st->cnt--; var2++) {
-            if (var2->c7 == ANODE && var2->i_args)
-                sub_583a(var2->i_args);
-            if (var2->dataType == DT_POINTER)
-                reduceNodeRef(var2->i_nextSym);
-        }
-        free(st);
+static bool sameArgs(register args_t *p, args_t *q) {
+    int16_t i;
+    s8_t *sp;
+    s8_t *sq;
+
+    if (p->cnt != q->cnt)
+        return false;
+    for (i = 0; i < p->cnt; i++) {
+        sp = &p->s8array[i];
+        sq = &q->s8array[i];
+        if (sp->i_nextSym != sq->i_nextSym || sp->i_sym != sq->i_sym || sp->i4 != sq->i4 ||
+            sp->dataType != sq->dataType || sp->c7 != sq->c7 || sp->ro != sq->ro)
+            return false;
     }
+    return true;
+}
+
+/**************************************************
+ * double the slots in argTab
+ **************************************************/
+static void growArgTab(void) {
+    args_t **newTab;
+    uint32_t newSize;
+    uint32_t i;
+    uint32_t j;
+
+    newSize = argSize ? argSize * 2 : HASHTABINIT;
+    newTab  = xalloc(newSize * sizeof(newTab[0]));
+    for (i = 0; i < argSize; i++)
+        if (argTab[i]) {
+            for (j = hashArgs(argTab[i]) & (newSize - 1); newTab[j]; j = (j + 1) & (newSize - 1))
+                ;
+            newTab[j] = argTab[i];
+        }
+    free(argTab);
+    argTab  = newTab;
+    argSize = newSize;
+}
+
+/**************************************************
+ * 120: 578D PMO +++
+ * argument lists are hash consed, identical lists,
+ * const included, share one copy so that copying a
+ * function type no longer duplicates its arguments
+ * and sub_591d can match them by address. Only the
+ * lists are shared, other descriptors are still
+ * copied and compared field by field. Nothing
+ * changes a list once made. The copies are kept in
+ * tuArena so they outlive a function body
+ **************************************************/
+args_t *sub_578d(register args_t *p) {
+    args_t *var2;
+    uint32_t i;
+
+    if (!p)
+        return p;
+    if (argCnt >= argSize / 2)
+        growArgTab();
+    for (i = hashArgs(p) & (argSize - 1); (var2 = argTab[i]); i = (i + 1) & (argSize - 1))
+        if (var2 == p || sameArgs(var2, p)) {
+            allocStats[AK_ARGS].shared++;
+            return var2;
+        }
+    var2 = arenaAllocIn(&tuArena, sizeof(args_t) + (p->cnt - 1) * sizeof(s8_t));
+    statAlloc(AK_ARGS, sizeof(args_t) + (p->cnt - 1) * sizeof(s8_t));
+    memcpy(var2, p, sizeof(args_t) + (p->cnt - 1) * sizeof(s8_t));
+    argCnt++;
+    return argTab[i] = var2;
 }
 
 /**************************************************
@@ -541,7 +857,7 @@ bool sub_591d(register s8_t *st, s8_t *p2) {
         }
         return sub_591d(st->i_nextInfo, p2->i_nextInfo);
     }
-    if (st->c7 != ANODE || !st->i_args || !p2->i_args)
+    if (st->c7 != ANODE || !st->i_args || !p2->i_args || st->i_args == p2->i_args)
         return true;
     if (st->i_args->cnt != p2->i_args->cnt)
         return false;
@@ -618,3 +934,21 @@ void sub_5b99(register s8_t *st) {
     if (sub_5a76(st, 0x16))
         *st = *(st->i_nextInfo);
 }
+
+/**************************************************
+ * the symbol table state a precompiled header
+ * keeps, hashtab itself is saved separately
+ **************************************************/
+void pchSymRoots(void) {
+    pchRoot(scopeHead, sizeof(scopeHead));
+    pchRoot(scopeTail, sizeof(scopeTail));
+    pchRoot(&symCnt, sizeof(symCnt));
+    pchRoot(&symPeak, sizeof(symPeak));
+    pchRoot(&lookupCnt, sizeof(lookupCnt));
+    pchRoot(&probeCnt, sizeof(probeCnt));
+    pchRoot(&maxProbe, sizeof(maxProbe));
+    pchRoot(&growCnt, sizeof(growCnt));
+    pchRoot(&scopeExits, sizeof(scopeExits));
+    pchRoot(&scopeSwept, sizeof(scopeSwept));
+    pchRoot(&nodeCnt, sizeof(nodeCnt));
+}
@@ -81,6 +81,7 @@ void sub_5c50(void) {
     bool vard;
     register sym_t *st;
 
+    blkclr(&var9, sizeof(var9)); /* padding included, -P compares nodes word by word */
     scFlags = sub_5dd1(&scType, &var9);
     if (scType != D_6 && scType != T_REGISTER && byte_a299 == D_6) {
         prError("only register storage class allowed");
@@ -104,6 +105,7 @@ void sub_5c50(void) {
                 sub_3c7e(st);
             } else {
                 sub_516c(st);
+                frameLocal(st);
                 sub_0493(st);
                 sub_6531(st);
             }
@@ -113,6 +115,7 @@ void sub_5c50(void) {
                 sub_516c(st);
             if (depth && scType == T_STATIC)
                 st->m18 |= 0x80;
+            frameLocal(st);
             sub_0493(st);
         } /* 5d95 */
         if (tok == T_ID || tok == T_STAR) {
@@ -147,13 +150,17 @@ uint8_t sub_5dd1(uint8_t *pscType, register s8_t *attr) {
     attr->i_sym     = 0;
     attr->i_nextSym = NULL;
     attr->c7        = 0;
+    attr->ro        = false;
     scType = dataType = 0;
     sizeIndicator     = 0;
     isUnsigned        = false;
     scFlags           = 0;
 
     for (;;) {
-        if ((tok = yylex()) == S_CLASS) {
+        tok = yylex();
+        if (tokConst) /* const among the specifiers, or just after them */
+            attr->ro = true;
+        if (tok == S_CLASS) {
             if (pscType == NULL)
                 prError("storage class illegal");
             else {
@@ -233,6 +240,8 @@ uint8_t sub_5dd1(uint8_t *pscType, register s8_t *attr) {
                 attr->u2 = var9->attr.u2;
                 attr->i4 = var9->attr.i4;
             }
+            if (var9->attr.ro)
+                attr->ro = true;
         } else
             break;
 
@@ -280,6 +289,7 @@ sym_t *sub_60db(uint8_t p1) {
     uint8_t tok;
     int16_t var7;
     s8_t varF;
+    arena_t *saveArena;
     register sym_t *st;
 
     byte_8f85 = true;
@@ -295,8 +305,12 @@ sym_t *sub_60db(uint8_t p1) {
         if (tok != T_LBRACE)
             expectErr("struct/union tag or '{'");
     }
-    var4 = 0;
+    var4      = 0;
+    saveArena = curArena;
     if (tok == T_LBRACE) {
+        /* members of a tag declared outside this function body must outlive it */
+        if (depth && !arenaOwns(&bodyArena, st))
+            curArena = &tuArena;
         if ((st->m18 & 0x81) == 1)
             prError("struct/union redefined: %s", st->nVName);
         else
@@ -349,11 +363,13 @@ sym_t *sub_60db(uint8_t p1) {
                     *var4 = st;
                     sub_0353(st, p1);
                 }
+                curArena = saveArena;
                 return st;
             }
             ungetTok = tok;
         }
     }
+    curArena = saveArena;
     ungetTok = tok;
     return st;
 }
@@ -369,6 +385,7 @@ sym_t *sub_6360(void) {
     uint8_t tok;
     register sym_t *st;
 
+    blkclr(&var8, sizeof(var8));
     if ((tok = yylex()) == T_ID) {
         st = yylval.ySym;
         if ((tok = yylex()) != T_LBRACE) {
@@ -389,9 +406,9 @@ sym_t *sub_6360(void) {
         var8.i4        = 0;
         var8.i_info    = 0;
         var8.c7        = 0;
-        printf("[c ");
-        sub_573b(st, stdout);
-        putchar('\n');
+        outStr(&irOut, "[c ");
+        sub_573b(st, &irOut);
+        outCh(&irOut, '\n');
         vare = 0;
         varc = sub_1b4b(0, DT_INT);
         for (;;) {
@@ -415,7 +432,7 @@ sym_t *sub_6360(void) {
                 varc = sub_25f7(varc);
             }
         }
-        printf(".. ]\n");
+        outStr(&irOut, ".. ]\n");
         sub_2569(varc);
         if (tok != T_RBRACE) {
             expectErr("}");
@@ -473,6 +490,8 @@ args_t *sub_65e2(uint16_t p1) {
     } args;
     register sym_t *st;
 
+    blkclr(&attr, sizeof(attr));
+    blkclr(&var1a, sizeof(var1a));
     var10          = byte_a299;
     byte_a299      = D_15;
     args.cnt       = 0;
@@ -484,6 +503,7 @@ args_t *sub_65e2(uint16_t p1) {
     var1a.c7       = 0;
     for (;;) { /* 6619 */
         if ((tok = yylex()) == T_3DOT) {
+            blkclr(&args.s8array[args.cnt], sizeof(s8_t));
             args.s8array[args.cnt].dataType = DT_VARGS;
             args.s8array[args.cnt].i_expr   = 0;
             args.s8array[args.cnt].c7       = 0;
@@ -577,6 +597,7 @@ sym_t *sub_69ca(uint8_t p1, register s8_t *p2, uint8_t p3, sym_t *p4) {
     uint8_t tok;
     s8_t var1b;
 
+    blkclr(&var1b, sizeof(var1b));
     var6             = p12_a297;
     p12_a297         = &var12;
     var1b.i_info     = NULL; /* other options */
@@ -592,6 +613,8 @@ sym_t *sub_69ca(uint8_t p1, register s8_t *p2, uint8_t p3, sym_t *p4) {
     p12_a297->uc9    = 0;
     p12_a297->uc8    = 0;
     p12_a297->ucb    = 0;
+    p12_a297->star   = false;
+    p12_a297->ro     = false;
     sub_6fab(p1);
     ungetTok = tok = yylex();
     if (p12_a297->ucb) {
@@ -650,6 +673,8 @@ sym_t *sub_69ca(uint8_t p1, register s8_t *p2, uint8_t p3, sym_t *p4) {
         (sub_5a76(p2, DT_STRUCT) || sub_5a76(p2, DT_UNION)) && p2->i_nextSym &&
         !(p2->i_nextSym->m18 & 1))
         prError("undefined struct/union: %s", p12_a297->p8->i_nextSym->nVName);
+    /* const int x, or int *const x. A const before a '*' is the pointee's */
+    var1b.ro = p12_a297->ro || (p2->ro && !p12_a297->star);
     if (p12_a297->p25) { /* 6e0b */
         if (byte_a299 == D_6 && p1 != D_MEMBER) {
             if (p12_a297->p25->m18 & 8)
@@ -698,8 +723,11 @@ void sub_6fab(uint8_t p1) {
     var2      = 0;
     while ((tok = yylex()) == T_STAR)
         var2++;
+    if (var2)
+        p12_a297->star = true;
     if (tok == T_ID) {
         p12_a297->p25 = yylval.ySym;
+        p12_a297->ro  = tokConst;
         tok           = yylex();
         var4          = p12_a297->p25->m20;
         if (p12_a297->p25->m20 == 0)
@@ -829,13 +857,17 @@ void sub_7454(register s8_t *st) {
     uint16_t var2;
     uint8_t var3;
 
-    putchar('`');
+    if (st->c7 != ANODE && st->i4 == 0 && st->dataType < DT_ENUM) {
+        outBasicSig(&irOut, st->dataType, true); /* common case, one string */
+        return;
+    }
+    outCh(&irOut, '`');
     for (;;) {
         if (st->c7 == ANODE)
-            putchar('(');
+            outCh(&irOut, '(');
         for (var2 = st->i4; var2; var2 >>= 1)
             if (var2 & 1)
-                putchar('*');
+                outCh(&irOut, '*');
         if (st->dataType == DT_POINTER && st->i_nextInfo->c7 == ANODE)
             st = st->i_nextInfo;
         else
@@ -845,18 +877,15 @@ void sub_7454(register s8_t *st) {
     switch (var3) {
     case DT_ENUM:
     case DT_POINTER:
-        sub_573b(st->i_nextSym, stdout);
+        sub_573b(st->i_nextSym, &irOut);
         break;
     case DT_STRUCT:
     case DT_UNION:
-        printf("S%d", st->i_nextSym->a_labelId);
+        outCh(&irOut, 'S');
+        outNum(&irOut, st->i_nextSym->a_labelId);
         break;
     default:
-        if (var3 & 1) {
-            putchar('u');
-            var3 &= ~1;
-        }
-        putchar("?bcsilxfd?v"[var3 >> 1]);
+        outBasicSig(&irOut, var3, false);
         break;
     }
 }
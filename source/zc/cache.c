@@ -0,0 +1,305 @@
+/*
+ * Content addressed object cache for zc3
+ *
+ * An object is stored as dir/xx/<rest of hash>.obj. The hash covers the
+ * preprocessed source, the p1x3, cgen3, optim3 and zasx3 binaries and the
+ * flags that change the code. A hit copies the entry to the object file
+ * and touches it, so an entry's mtime is its last use. dir/stats keeps
+ * the running hit and miss counts and the size of the cache. When a run
+ * leaves the cache over its limit (ZC_CACHE_SIZE, default 64M) the least
+ * recently used entries are removed until it is back under 90% of it.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "zc.h"
+
+#define CACHEVERSION "zc3 cache 1\n"
+#define DEFLIMIT     (64L << 20)
+
+typedef struct {
+    char *path;
+    time_t used;
+    off_t size;
+} entry_t;
+
+static char *cacheDir;
+static long long limit;
+static long hits;
+static long misses;
+static long long added; /* bytes stored this run */
+
+/**************************************************
+ * copy file from to the open file out
+ **************************************************/
+static bool copyFile(char *from, int out) {
+    char buf[0x4000];
+    ssize_t n;
+    int in;
+
+    if ((in = open(from, O_RDONLY)) < 0)
+        return false;
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+        if (write(out, buf, n) != n) {
+            n = -1;
+            break;
+        }
+    close(in);
+    return n == 0;
+}
+
+static void entryPath(char *path, uint8_t key[32]) {
+    int i;
+    char *s;
+
+    s = path + sprintf(path, "%s/%02x/", cacheDir, key[0]);
+    for (i = 1; i < 32; i++)
+        s += sprintf(s, "%02x", key[i]);
+    strcpy(s, ".obj");
+}
+
+/**************************************************
+ * read the size limit and make sure the directory
+ * is there
+ **************************************************/
+bool cacheInit(char *dir) {
+    char *s;
+    char *end;
+
+    limit = DEFLIMIT;
+    if ((s = getenv("ZC_CACHE_SIZE")) && *s) {
+        limit = strtoll(s, &end, 10);
+        switch (*end) {
+        case 'G':
+        case 'g':
+            limit <<= 10;
+            /* fall through */
+        case 'M':
+        case 'm':
+            limit <<= 10;
+            /* fall through */
+        case 'K':
+        case 'k':
+            limit <<= 10;
+        }
+    }
+    if (mkdir(dir, 0777) < 0 && access(dir, W_OK) < 0) {
+        error("can't use cache directory %s", dir);
+        return false;
+    }
+    cacheDir = xstrdup(dir);
+    return true;
+}
+
+/**************************************************
+ * start a key with the tools and flags, the tools
+ * are hashed once per run
+ **************************************************/
+void cacheKeyInit(sha256_t *sp, char **tools, int ntools, char *flags) {
+    static uint8_t toolDigest[32];
+    static bool haveDigest;
+    sha256_t tsp;
+    char buf[0x4000];
+    ssize_t n;
+    int fd;
+    int i;
+
+    if (!haveDigest) {
+        sha256Init(&tsp);
+        for (i = 0; i < ntools; i++) {
+            if ((fd = open(tools[i], O_RDONLY)) < 0)
+                fatal("can't read %s", tools[i]);
+            while ((n = read(fd, buf, sizeof(buf))) > 0)
+                sha256Add(&tsp, buf, n);
+            close(fd);
+        }
+        sha256End(&tsp, toolDigest);
+        haveDigest = true;
+    }
+    sha256Init(sp);
+    sha256Add(sp, CACHEVERSION, strlen(CACHEVERSION));
+    sha256Add(sp, toolDigest, sizeof(toolDigest));
+    sha256Add(sp, flags, strlen(flags) + 1);
+}
+
+/**************************************************
+ * copy a cached object to obj, true on a hit
+ **************************************************/
+bool cacheGet(uint8_t key[32], char *obj) {
+    char path[PATH_MAX];
+    int out;
+    bool ok;
+
+    entryPath(path, key);
+    if (access(path, R_OK) == 0 && (out = open(obj, O_WRONLY | O_CREAT | O_TRUNC, 0666)) >= 0) {
+        ok = copyFile(path, out);
+        if (close(out) < 0)
+            ok = false;
+        if (ok) {
+            utimensat(AT_FDCWD, path, NULL, 0);
+            hits++;
+            return true;
+        }
+        unlink(obj);
+    }
+    misses++;
+    return false;
+}
+
+/**************************************************
+ * store a freshly built object, written to a temp
+ * file and renamed so other runs never see part of
+ * an entry
+ **************************************************/
+void cachePut(uint8_t key[32], char *obj) {
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    struct stat st;
+    int out;
+    bool ok;
+
+    entryPath(path, key);
+    strcpy(tmp, path);
+    strcpy(strrchr(tmp, '/'), "");
+    mkdir(tmp, 0777);
+    strcat(tmp, "/.tmpXXXXXX");
+    if ((out = mkstemp(tmp)) < 0)
+        return;
+    ok = copyFile(obj, out) && fstat(out, &st) == 0;
+    if (close(out) == 0 && ok && rename(tmp, path) == 0)
+        added += st.st_size;
+    else
+        unlink(tmp);
+}
+
+static int byUse(const void *a, const void *b) {
+    const entry_t *ea = a;
+    const entry_t *eb = b;
+
+    return ea->used < eb->used ? -1 : ea->used > eb->used;
+}
+
+/**************************************************
+ * scan the cache, dropping the least recently used
+ * entries if it is over the limit. returns the size
+ * left
+ **************************************************/
+static long long evict(void) {
+    char path[PATH_MAX];
+    entry_t *entries = NULL;
+    int cnt          = 0;
+    int max          = 0;
+    long long size   = 0;
+    struct dirent *dp;
+    struct dirent *fp;
+    struct stat st;
+    DIR *top;
+    DIR *sub;
+    int i;
+
+    if (!(top = opendir(cacheDir)))
+        return 0;
+    while ((dp = readdir(top)))
+        if (strlen(dp->d_name) == 2 && dp->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", cacheDir, dp->d_name);
+            if (!(sub = opendir(path)))
+                continue;
+            while ((fp = readdir(sub))) {
+                if (!strstr(fp->d_name, ".obj"))
+                    continue;
+                snprintf(path, sizeof(path), "%s/%s/%s", cacheDir, dp->d_name, fp->d_name);
+                if (stat(path, &st) < 0)
+                    continue;
+                if (cnt == max)
+                    if (!(entries = realloc(entries, (max = max ? max * 2 : 256) * sizeof(entry_t))))
+                        fatal("out of memory");
+                entries[cnt].path   = xstrdup(path);
+                entries[cnt].used   = st.st_mtime;
+                entries[cnt++].size = st.st_size;
+                size += st.st_size;
+            }
+            closedir(sub);
+        }
+    closedir(top);
+    if (size > limit) {
+        qsort(entries, cnt, sizeof(entry_t), byUse);
+        for (i = 0; i < cnt && size > limit / 10 * 9; i++)
+            if (unlink(entries[i].path) == 0)
+                size -= entries[i].size;
+    }
+    for (i = 0; i < cnt; i++)
+        free(entries[i].path);
+    free(entries);
+    return size;
+}
+
+static void readStats(long *h, long *m, long long *size) {
+    char path[PATH_MAX];
+    FILE *fp;
+
+    *h = *m = 0;
+    *size   = 0;
+    snprintf(path, sizeof(path), "%s/stats", cacheDir);
+    if ((fp = fopen(path, "r"))) {
+        if (fscanf(fp, "hits %ld misses %ld size %lld", h, m, size) != 3)
+            *size = -1;
+        fclose(fp);
+    } else
+        *size = -1;
+}
+
+/**************************************************
+ * add this run's figures to the stats and keep the
+ * cache within its limit. the lock stops two runs
+ * updating the stats at once
+ **************************************************/
+void cacheEnd(bool verbose) {
+    char path[PATH_MAX];
+    long h;
+    long m;
+    long long size;
+    int lock;
+    FILE *fp;
+
+    if (!cacheDir || hits + misses == 0)
+        return;
+    if (verbose)
+        fprintf(stderr, "%s: cache %ld hits, %ld misses\n", progName, hits, misses);
+    snprintf(path, sizeof(path), "%s/lock", cacheDir);
+    if ((lock = open(path, O_RDWR | O_CREAT, 0666)) < 0 || flock(lock, LOCK_EX) < 0)
+        return;
+    readStats(&h, &m, &size);
+    if (size < 0 || (size += added) > limit) /* missing stats are rebuilt by a scan */
+        size = evict();
+    snprintf(path, sizeof(path), "%s/stats", cacheDir);
+    if ((fp = fopen(path, "w"))) {
+        fprintf(fp, "hits %ld misses %ld size %lld\n", h + hits, m + misses, size);
+        fclose(fp);
+    }
+    close(lock);
+}
+
+/**************************************************
+ * print the running totals for -s
+ **************************************************/
+void cacheStats(void) {
+    long h;
+    long m;
+    long long size;
+
+    readStats(&h, &m, &size);
+    if (size < 0)
+        size = evict();
+    printf("cache directory %s\n", cacheDir);
+    printf("hits            %ld\n", h);
+    printf("misses          %ld\n", m);
+    if (h + m)
+        printf("hit rate        %.1f%%\n", 100.0 * h / (h + m));
+    printf("size            %lld KB (limit %lld KB)\n", size >> 10, limit >> 10);
+}
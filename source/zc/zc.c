@@ -0,0 +1,1011 @@
+/*
+ * zc3 - native compiler driver for the Hi-Tech C tools in bin/
+ *
+ * A Linux counterpart of ZC.EXE for compiling to objects. Each C source
+ * goes through
+ *
+ *     cpp_new3 | p1x3 | cgen3 [| optim3] > tmp; zasx3 -oname.obj tmp
+ *
+ * with the stages joined by pipes so they run at the same time. Only the
+ * assembler input touches the disk, zasx3 reads it twice. .as sources
+ * go straight to zasx3. With -j several sources are compiled at once,
+ * and when run from make the extra job slots come from the GNU make
+ * jobserver.
+ *
+ * With a cache directory (-C or $ZC_CACHE) the preprocessor output is
+ * read by zc3 itself and hashed, see cache.c. A hit copies the object
+ * out of the cache, a miss feeds the output on to p1x3 and stores the
+ * object built.
+ *
+ * usage: zc3 [-jN] [-O] [-k] [-v] [-M] [-Bdir] [-Cdir] [-ddir] [-o file.obj]
+ *            [-Ffile] [-Idir] [-Dname[=val]] [-Uname] file.c|file.as ...
+ *        zc3 -s [-Cdir]
+ *
+ *  -jN  compile up to N sources at a time, -j alone one per CPU
+ *  -O   run the optim3 peephole optimiser
+ *  -k   keep name.i, name.p1, name.as and name.asm
+ *  -v   show the commands run
+ *  -M   write name.d, a make rule giving the files each object was made
+ *       from. p1x3 -M writes it, or zc3 itself when it has read the
+ *       preprocessor output for the cache
+ *  -B   directory holding the tools, default the one holding zc3
+ *  -C   object cache directory, not used with -k
+ *  -s   show the cache statistics
+ *  -d   directory for the objects and kept files
+ *  -o   object file name, only with a single source
+ *  -F   the sources are a whole program. They are first all run through
+ *       p1x3 -Gfile to collect its call graph in file, then compiled
+ *       with p1x3 -Ffile, which keeps the locals of the functions that
+ *       are never re-entered in one static area. Not cached
+ *
+ * Objects and kept files are written to the current directory unless
+ * -d gives another.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "zc.h"
+
+#define MAXJOBS  256
+#define MAXSTAGE 8 /* 4 tools + 3 tee, or feed + 3 tools */
+#define MAXARGS  256
+
+enum { PENDING, PREPROCESSING, COMPILING, ASSEMBLING, DONE };
+
+typedef struct {
+    char *src;               /* source as given */
+    char *base;              /* source without directory and suffix */
+    char *obj;               /* object file */
+    char *dep;               /* -M make rule */
+    char asmFile[PATH_MAX];  /* zasx3 input */
+    bool tmpAsm;             /* asmFile is ours to remove */
+    pid_t pids[MAXSTAGE];    /* children of the current step, 0 once reaped */
+    char *names[MAXSTAGE];   /* and what they run */
+    int status[MAXSTAGE];    /* and how they ended */
+    int nstages;
+    int npids;               /* still running */
+    int state;
+    bool failed;
+    int inFd;                /* preprocessor output when caching */
+    char *ibuf;              /* and what has been read of it */
+    size_t ilen;
+    size_t isize;
+    sha256_t hash;
+    uint8_t key[32];
+    bool store;              /* put the object in the cache */
+} unit_t;
+
+typedef struct {
+    char **argv;  /* command to run, or NULL for tee / feed */
+    char *tee;    /* file the tee copies to */
+    char *feed;   /* else data written to the pipe */
+    size_t feedLen;
+} stage_t;
+
+char *progName = "zc3";
+static char toolDir[PATH_MAX];
+static char *cppTool;
+static char *p1Tool;
+static char *cgenTool;
+static char *optimTool;
+static char *zasTool;
+static char *cppArgs[MAXARGS];
+static int cppArgCnt;
+static bool o_opt;
+static bool k_opt;
+static bool v_opt;
+static bool m_opt;
+static char *objDir;
+static char *objName;
+static char *frameFile; /* -F */
+static bool graphPass;  /* collecting the call graph for -F */
+static int jobs;
+static bool caching;
+
+static unit_t *units;
+static int unitCnt;
+static int failCnt;
+static int running;
+
+static int sigPipe[2] = { -1, -1 };
+static int tokRd = -1; /* jobserver, read side opened non blocking */
+static int tokWr = -1;
+static char tokens[MAXJOBS]; /* tokens held, handed back as read */
+static int tokenCnt;
+
+/**************************************************
+ * report an error in the driver itself
+ **************************************************/
+static void verror(char *fmt, va_list args) {
+    fprintf(stderr, "%s: ", progName);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+}
+
+void error(char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    verror(fmt, args);
+    va_end(args);
+}
+
+void fatal(char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    verror(fmt, args);
+    va_end(args);
+    exit(1);
+}
+
+void *xmalloc(size_t size) {
+    void *p;
+
+    if (!(p = malloc(size)))
+        fatal("out of memory");
+    return p;
+}
+
+char *xstrdup(char *s) {
+    return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+/**************************************************
+ * base name + new suffix
+ **************************************************/
+static char *withSuffix(char *base, char *suffix) {
+    char *s = xmalloc(strlen(base) + strlen(suffix) + 1);
+
+    return strcat(strcpy(s, base), suffix);
+}
+
+static char *tool(char *name) {
+    char *s = xmalloc(strlen(toolDir) + strlen(name) + 2);
+
+    sprintf(s, "%s/%s", toolDir, name);
+    return s;
+}
+
+/**************************************************
+ * tools default to the directory zc3 was run from
+ **************************************************/
+static void findTools(char *argv0) {
+    char *s;
+    ssize_t len;
+
+    if (!*toolDir) {
+        if ((len = readlink("/proc/self/exe", toolDir, sizeof(toolDir) - 1)) > 0)
+            toolDir[len] = '\0';
+        else
+            snprintf(toolDir, sizeof(toolDir), "%s", argv0);
+        if ((s = strrchr(toolDir, '/')))
+            *s = '\0';
+        else
+            strcpy(toolDir, ".");
+    }
+    cppTool   = tool("cpp_new3");
+    p1Tool    = tool("p1x3");
+    cgenTool  = tool("cgen3");
+    optimTool = tool("optim3");
+    zasTool   = tool("zasx3");
+}
+
+/**************************************************
+ * SIGCHLD wakes the main loop through sigPipe
+ **************************************************/
+static void onChild(int sig) {
+    int err = errno;
+
+    (void)sig;
+    (void)!write(sigPipe[1], "", 1);
+    errno = err;
+}
+
+/**************************************************
+ * on an interrupt remove the temporary and partial
+ * files before dying, only async safe calls here
+ **************************************************/
+static void onKill(int sig) {
+    int i;
+
+    for (i = 0; i < unitCnt; i++)
+        if (units[i].state != PENDING && units[i].state != DONE) {
+            if (units[i].tmpAsm)
+                unlink(units[i].asmFile);
+            unlink(units[i].obj);
+            if (units[i].dep)
+                unlink(units[i].dep);
+        }
+    for (i = 0; i < tokenCnt; i++)
+        (void)!write(tokWr, &tokens[i], 1);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**************************************************
+ * pick up the jobserver from MAKEFLAGS, either
+ * --jobserver-auth=R,W (--jobserver-fds for older
+ * makes) or --jobserver-auth=fifo:PATH. The read side
+ * is reopened so it can be non blocking without
+ * affecting make or the other jobs sharing the pipe
+ **************************************************/
+static bool joinJobserver(void) {
+    char *flags;
+    char *s;
+    char *e;
+    int rd;
+    int wr;
+    char path[64];
+
+    if (!(flags = getenv("MAKEFLAGS")))
+        return false;
+    s = NULL;
+    for (e = flags; (e = strstr(e, "--jobserver-")); e++)
+        if (!strncmp(e, "--jobserver-auth=", 17))
+            s = e + 17;
+        else if (!strncmp(e, "--jobserver-fds=", 16))
+            s = e + 16;
+    if (!s)
+        return false;
+    if (!strncmp(s, "fifo:", 5)) {
+        s = xstrdup(s + 5);
+        if ((e = strchr(s, ' ')))
+            *e = '\0';
+        tokRd = open(s, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        tokWr = open(s, O_WRONLY | O_CLOEXEC);
+        free(s);
+    } else if (sscanf(s, "%d,%d", &rd, &wr) == 2 && fcntl(rd, F_GETFD) >= 0 &&
+               fcntl(wr, F_GETFD) >= 0) {
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", rd);
+        tokRd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        tokWr = wr;
+        fcntl(wr, F_SETFD, FD_CLOEXEC);
+    }
+    if (tokRd < 0 || tokWr < 0) {
+        if (tokRd >= 0)
+            close(tokRd);
+        tokRd = -1;
+        return false;
+    }
+    return true;
+}
+
+static bool getToken(void) {
+    if (tokRd < 0 || tokenCnt == MAXJOBS || read(tokRd, &tokens[tokenCnt], 1) != 1)
+        return false;
+    tokenCnt++;
+    return true;
+}
+
+static void putToken(void) {
+    if (tokenCnt)
+        (void)!write(tokWr, &tokens[--tokenCnt], 1);
+}
+
+static void showCmd(char **argv, char *out, bool more) {
+    fputs(*argv, stderr);
+    while (*++argv)
+        fprintf(stderr, " %s", *argv);
+    if (out)
+        fprintf(stderr, " > %s", out);
+    fputs(more ? " | " : "\n", stderr);
+}
+
+/**************************************************
+ * in a forked child, copy stdin to stdout and file
+ **************************************************/
+static void tee(char *file) {
+    char buf[0x10000];
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+        error("can't create %s", file);
+        _exit(1);
+    }
+    while ((n = read(0, buf, sizeof(buf))) > 0)
+        if (write(1, buf, n) != n || write(fd, buf, n) != n)
+            _exit(1);
+    _exit(n < 0 || close(fd) < 0);
+}
+
+/**************************************************
+ * in a forked child, write the data to stdout
+ **************************************************/
+static void feed(char *data, size_t len) {
+    ssize_t n;
+
+    signal(SIGPIPE, SIG_DFL);
+    for (; len; data += n, len -= n)
+        if ((n = write(1, data, len)) <= 0)
+            _exit(1);
+    _exit(0);
+}
+
+/**************************************************
+ * start the stages as a pipeline writing to outFd,
+ * outName for -v. the pids go into the unit
+ **************************************************/
+static bool startPipe(unit_t *up, stage_t *stages, int n, int outFd, char *outName) {
+    int in = -1;
+    int p[2];
+    int out;
+    int i;
+    pid_t pid;
+
+    up->npids = 0;
+    for (i = 0; i < n; i++) {
+        p[0] = p[1] = -1;
+        if (i < n - 1) {
+            if (pipe(p) < 0) {
+                error("can't create pipe");
+                break;
+            }
+            out = p[1];
+        } else
+            out = outFd;
+        if (v_opt && stages[i].argv)
+            showCmd(stages[i].argv, i == n - 1 ? outName : NULL, i < n - 1);
+        if ((pid = fork()) == 0) {
+            if (in >= 0) {
+                dup2(in, 0);
+                close(in);
+            }
+            if (out >= 0 && out != 1) {
+                dup2(out, 1);
+                close(out);
+            }
+            if (p[0] >= 0)
+                close(p[0]);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGCHLD, SIG_DFL);
+            if (stages[i].feed)
+                feed(stages[i].feed, stages[i].feedLen);
+            if (!stages[i].argv)
+                tee(stages[i].tee);
+            execv(stages[i].argv[0], stages[i].argv);
+            error("can't run %s", stages[i].argv[0]);
+            _exit(127);
+        }
+        if (in >= 0)
+            close(in);
+        if (p[1] >= 0)
+            close(p[1]);
+        in = p[0];
+        if (pid < 0) {
+            error("can't fork");
+            break;
+        }
+        up->names[up->npids] = stages[i].argv ? strrchr(stages[i].argv[0], '/') + 1
+                               : stages[i].feed ? "feed" : "tee";
+        up->pids[up->npids++] = pid;
+    }
+    up->nstages = up->npids;
+    if (in >= 0)
+        close(in);
+    return i == n;
+}
+
+/**************************************************
+ * assemble the unit's asmFile into its object
+ **************************************************/
+static void assemble(unit_t *up) {
+    stage_t stage;
+    char *argv[4];
+
+    argv[0]    = zasTool;
+    argv[1]    = withSuffix("-o", up->obj);
+    argv[2]    = up->asmFile;
+    argv[3]    = NULL;
+    memset(&stage, 0, sizeof(stage));
+    stage.argv = argv;
+    up->state  = ASSEMBLING;
+    if (!startPipe(up, &stage, 1, -1, NULL))
+        up->failed = true;
+    free(argv[1]);
+}
+
+/**************************************************
+ * tidy up after a unit, the object is removed if
+ * any step failed
+ **************************************************/
+static void finish(unit_t *up) {
+    if (up->tmpAsm)
+        unlink(up->asmFile);
+    if (up->failed) {
+        unlink(up->obj);
+        if (up->dep)
+            unlink(up->dep);
+        failCnt++;
+    } else if (up->store)
+        cachePut(up->key, up->obj);
+    if (up->inFd >= 0)
+        close(up->inFd);
+    free(up->ibuf);
+    up->ibuf  = NULL;
+    up->state = DONE;
+    running--;
+}
+
+/**************************************************
+ * the .d file that goes with obj
+ **************************************************/
+static char *depName(char *obj) {
+    char *s = xstrdup(obj);
+    char *t;
+
+    if ((t = strrchr(s, '.')) && !strchr(t, '/'))
+        *t = '\0';
+    t = withSuffix(s, ".d");
+    free(s);
+    return t;
+}
+
+/* a name as make wants it */
+static void putName(char *s, size_t len, FILE *fp) {
+    for (; len--; s++) {
+        if (*s == ' ' || *s == '\t' || *s == '#')
+            fputc('\\', fp);
+        else if (*s == '$')
+            fputc('$', fp);
+        fputc(*s, fp);
+    }
+}
+
+/**************************************************
+ * write the -M rule from the line markers in the
+ * preprocessor output, as p1x3 -M would
+ **************************************************/
+static void writeDeps(unit_t *up) {
+    char *end = up->ibuf + up->ilen;
+    char **names = NULL;
+    size_t *lens = NULL;
+    int cnt      = 0;
+    char *s;
+    char *t;
+    char *nl;
+    FILE *fp;
+    int i;
+
+    for (s = up->ibuf; s < end; s = nl + 1) {
+        if (!(nl = memchr(s, '\n', end - s)))
+            nl = end;
+        if (*s != '#')
+            continue;
+        for (t = s + 1; t < nl && (*t == ' ' || *t == '\t'); t++)
+            ;
+        if (t == nl || *t < '0' || *t > '9')
+            continue;
+        while (t < nl && *t >= '0' && *t <= '9')
+            t++;
+        while (t < nl && (*t == ' ' || *t == '\t'))
+            t++;
+        if (t == nl || *t++ != '"' || !(s = memchr(t, '"', nl - t)) || s == t)
+            continue;
+        for (i = 0; i < cnt; i++)
+            if (lens[i] == (size_t)(s - t) && memcmp(names[i], t, s - t) == 0)
+                break;
+        if (i < cnt)
+            continue;
+        if (!(cnt & 31) && (!(names = realloc(names, (cnt + 32) * sizeof(char *))) ||
+                            !(lens = realloc(lens, (cnt + 32) * sizeof(size_t)))))
+            fatal("out of memory");
+        names[cnt]  = t;
+        lens[cnt++] = s - t;
+    }
+    if (!(fp = fopen(up->dep, "w")))
+        error("can't create %s", up->dep);
+    else {
+        putName(up->obj, strlen(up->obj), fp);
+        fputc(':', fp);
+        for (i = 0; i < cnt; i++) {
+            fputs(" \\\n  ", fp);
+            putName(names[i], lens[i], fp);
+        }
+        fputc('\n', fp);
+        for (i = 1; i < cnt; i++) {
+            fputc('\n', fp);
+            putName(names[i], lens[i], fp);
+            fputs(":\n", fp);
+        }
+        if (fclose(fp) == EOF)
+            error("can't write %s", up->dep);
+    }
+    free(names);
+    free(lens);
+}
+
+/**************************************************
+ * open the unit's assembler input, kept with -k
+ * else a temporary
+ **************************************************/
+static int asmOut(unit_t *up) {
+    int fd;
+
+    if (k_opt) {
+        snprintf(up->asmFile, sizeof(up->asmFile), "%s%s", up->base, o_opt ? ".asm" : ".as");
+        fd = open(up->asmFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    } else {
+        snprintf(up->asmFile, sizeof(up->asmFile), "%s/zcXXXXXX",
+                 getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+        if ((fd = mkstemp(up->asmFile)) >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            up->tmpAsm = true;
+        }
+    }
+    return fd;
+}
+
+static void cppArgv(char **argv, char *src) {
+    int i;
+
+    argv[0] = cppTool;
+    for (i = 0; i < cppArgCnt; i++)
+        argv[i + 1] = cppArgs[i];
+    argv[i + 1] = src;
+    argv[i + 2] = NULL;
+}
+
+/**************************************************
+ * start the pipeline up to the optimiser writing
+ * the assembler input. it starts with the
+ * preprocessor, or with the preprocessor output
+ * already read when caching
+ **************************************************/
+static void compile(unit_t *up, char *data, size_t len) {
+    stage_t stages[MAXSTAGE];
+    char *cpp[MAXARGS + 3];
+    char *p1[4];
+    char *cgen[2];
+    char *optim[2];
+    int n = 0;
+    int i;
+    int fd;
+
+    memset(stages, 0, sizeof(stages));
+    p1[0]    = p1Tool;
+    cgen[0]  = cgenTool;
+    optim[0] = optimTool;
+    p1[1] = p1[2] = p1[3] = cgen[1] = optim[1] = NULL;
+
+    i = 1;
+    if (graphPass)
+        p1[i++] = withSuffix("-G", frameFile);
+    else if (frameFile)
+        p1[i++] = withSuffix("-F", frameFile);
+    if (up->dep && !data && !graphPass) /* else written from data */
+        p1[i++] = withSuffix("-M", up->dep);
+
+    if (data) {
+        stages[n].feed      = data;
+        stages[n++].feedLen = len;
+    } else {
+        cppArgv(cpp, up->src);
+        stages[n++].argv = cpp;
+    }
+    if (graphPass) { /* only the call graph is wanted */
+        stages[n++].argv = p1;
+        strcpy(up->asmFile, "/dev/null");
+        fd = open(up->asmFile, O_WRONLY | O_CLOEXEC);
+    } else {
+        if (k_opt)
+            stages[n].argv = NULL, stages[n++].tee = withSuffix(up->base, ".i");
+        stages[n++].argv = p1;
+        if (k_opt)
+            stages[n].argv = NULL, stages[n++].tee = withSuffix(up->base, ".p1");
+        stages[n++].argv = cgen;
+        if (o_opt) {
+            if (k_opt)
+                stages[n].argv = NULL, stages[n++].tee = withSuffix(up->base, ".as");
+            stages[n++].argv = optim;
+        }
+        fd = asmOut(up);
+    }
+    up->state = COMPILING;
+    if (fd < 0) {
+        error("can't create %s", up->asmFile);
+        up->failed = true;
+    } else {
+        if (!startPipe(up, stages, n, fd, up->asmFile))
+            up->failed = true;
+        close(fd);
+    }
+    for (i = 0; i < n; i++)
+        free(stages[i].tee);
+    for (i = 1; p1[i]; i++)
+        free(p1[i]);
+}
+
+/**************************************************
+ * start the preprocessor with its output coming
+ * back to zc3 on inFd
+ **************************************************/
+static void preprocess(unit_t *up) {
+    stage_t stage;
+    char *cpp[MAXARGS + 3];
+    char *tools[4];
+    int p[2];
+
+    tools[0] = p1Tool;
+    tools[1] = cgenTool;
+    tools[2] = optimTool;
+    tools[3] = zasTool;
+    cacheKeyInit(&up->hash, tools, 4, o_opt ? "-O" : "");
+    up->state = PREPROCESSING;
+    if (pipe(p) < 0) {
+        error("can't create pipe");
+        up->failed = true;
+        return;
+    }
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    fcntl(p[0], F_SETFD, FD_CLOEXEC);
+    memset(&stage, 0, sizeof(stage));
+    cppArgv(cpp, up->src);
+    stage.argv = cpp;
+    if (startPipe(up, &stage, 1, p[1], NULL))
+        up->inFd = p[0];
+    else {
+        up->failed = true;
+        close(p[0]);
+    }
+    close(p[1]);
+}
+
+/**************************************************
+ * start on a unit, the preprocessor to optimiser
+ * pipeline for C, the assembler for .as
+ **************************************************/
+static void startUnit(unit_t *up) {
+    char *s;
+
+    running++;
+    if (!(s = strrchr(up->src, '.')) || strcmp(s, ".c")) {
+        strcpy(up->asmFile, up->src);
+        if (!graphPass)
+            assemble(up);
+    } else if (caching && !k_opt)
+        preprocess(up);
+    else
+        compile(up, NULL, 0);
+    if (!up->npids) /* nothing started */
+        finish(up);
+}
+
+/**************************************************
+ * the preprocessor has finished and its output has
+ * all been read. on a cache hit the unit is done,
+ * else the rest of the pipeline is started on it
+ **************************************************/
+static void preprocessed(unit_t *up) {
+    if (!up->failed) {
+        sha256End(&up->hash, up->key);
+        if (up->dep)
+            writeDeps(up);
+        if (cacheGet(up->key, up->obj)) {
+            if (v_opt)
+                fprintf(stderr, "%s: %s: from the cache\n", progName, up->src);
+        } else {
+            up->store = true;
+            compile(up, up->ibuf, up->ilen);
+            free(up->ibuf);
+            up->ibuf = NULL;
+            if (up->npids)
+                return;
+        }
+    }
+    finish(up);
+}
+
+/**************************************************
+ * read what the preprocessor has written so far
+ **************************************************/
+static void readInput(unit_t *up) {
+    ssize_t n;
+
+    for (;;) {
+        if (up->ilen == up->isize) {
+            up->isize = up->isize ? up->isize * 2 : 0x10000;
+            if (!(up->ibuf = realloc(up->ibuf, up->isize)))
+                fatal("out of memory");
+        }
+        if ((n = read(up->inFd, up->ibuf + up->ilen, up->isize - up->ilen)) > 0) {
+            sha256Add(&up->hash, up->ibuf + up->ilen, n);
+            up->ilen += n;
+        } else if (n == 0 || errno != EAGAIN) {
+            if (n < 0)
+                up->failed = true;
+            close(up->inFd);
+            up->inFd = -1;
+            if (!up->npids)
+                preprocessed(up);
+            return;
+        } else
+            return;
+    }
+}
+
+/**************************************************
+ * a child has exited, move its unit on when all of
+ * the current step's processes are done. a stage
+ * that fails stops the ones after it, which would
+ * only work on partial input. a crash is reported
+ * once all are done, and only if no earlier stage
+ * had failed
+ **************************************************/
+static void childDone(unit_t *up, int i, int status) {
+    int j;
+
+    up->status[i] = status;
+    up->pids[i]   = 0;
+    --up->npids;
+    if (WIFEXITED(status) && WEXITSTATUS(status))
+        for (j = i + 1; j < up->nstages; j++)
+            if (up->pids[j])
+                kill(up->pids[j], SIGTERM);
+    if (up->npids)
+        return;
+    for (j = 0; j < up->nstages; j++) {
+        status = up->status[j];
+        if (WIFSIGNALED(status) && WTERMSIG(status) != SIGPIPE) {
+            if (!up->failed)
+                error("%s: %s died with signal %d", up->src, up->names[j], WTERMSIG(status));
+            up->failed = true;
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status))
+            up->failed = true;
+    }
+    if (up->state == PREPROCESSING) {
+        if (up->inFd < 0)
+            preprocessed(up);
+        return;
+    }
+    if (up->state == COMPILING && !up->failed && !graphPass) {
+        assemble(up);
+        if (up->npids)
+            return;
+    }
+    finish(up);
+}
+
+/**************************************************
+ * collect exited children
+ **************************************************/
+static void reap(void) {
+    pid_t pid;
+    int status;
+    int i;
+    int j;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        for (i = 0; i < unitCnt; i++)
+            for (j = 0; j < units[i].nstages; j++)
+                if (units[i].pids[j] == pid) {
+                    childDone(&units[i], j, status);
+                    i = unitCnt;
+                    break;
+                }
+}
+
+/**************************************************
+ * run the units keeping up to jobs of them going.
+ * one runs on the slot make gave us, each of the
+ * others needs a jobserver token, handed back as
+ * soon as fewer units are running. no new units are
+ * started after a failure
+ **************************************************/
+static int compileAll(void) {
+    struct pollfd *fds = xmalloc((unitCnt + 2) * sizeof(struct pollfd));
+    int next           = 0;
+    int nfds;
+    char buf[64];
+    int i;
+
+    for (;;) {
+        while (next < unitCnt && running < jobs && !failCnt) {
+            if (running > tokenCnt && !getToken())
+                break;
+            startUnit(&units[next++]);
+        }
+        while (tokenCnt && tokenCnt >= running)
+            putToken();
+        if (!running)
+            break;
+        fds[0].fd     = sigPipe[0];
+        fds[0].events = POLLIN;
+        nfds          = 1;
+        if (next < unitCnt && running < jobs && !failCnt && tokRd >= 0) {
+            fds[1].fd     = tokRd;
+            fds[1].events = POLLIN;
+            nfds          = 2;
+        }
+        for (i = 0; i < unitCnt; i++)
+            if (units[i].state == PREPROCESSING && units[i].inFd >= 0) {
+                fds[nfds].fd       = units[i].inFd;
+                fds[nfds++].events = POLLIN;
+            }
+        if (poll(fds, nfds, -1) < 0 && errno != EINTR)
+            fatal("poll failed");
+        while (read(sigPipe[0], buf, sizeof(buf)) > 0)
+            ;
+        for (i = 0; i < unitCnt; i++)
+            if (units[i].state == PREPROCESSING && units[i].inFd >= 0)
+                readInput(&units[i]);
+        reap();
+    }
+    free(fds);
+    return failCnt;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: %s [-jN] [-O] [-k] [-v] [-M] [-Bdir] [-Cdir] [-ddir] [-o file.obj] [-Ffile] "
+            "[-Idir] [-Dname[=val]] "
+            "[-Uname] file.c|file.as ...\n"
+            "       %s -s [-Cdir]\n",
+            progName, progName);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int i;
+    char *s;
+    char *t;
+    struct sigaction sa;
+    char *cacheDir = getenv("ZC_CACHE");
+    bool s_opt     = false;
+    int failed;
+    FILE *fp;
+
+    if ((s = strrchr(argv[0], '/')))
+        progName = s + 1;
+    else
+        progName = argv[0];
+    units = xmalloc(argc * sizeof(unit_t));
+    memset(units, 0, argc * sizeof(unit_t));
+
+    for (i = 1; i < argc; i++) {
+        s = argv[i];
+        if (*s != '-' || !s[1]) {
+            units[unitCnt++].src = s;
+            continue;
+        }
+        switch (s[1]) {
+        case 'I':
+        case 'D':
+        case 'U':
+            if (cppArgCnt == MAXARGS)
+                fatal("too many -I/-D/-U options");
+            cppArgs[cppArgCnt++] = s;
+            break;
+        case 'j':
+            if (s[2])
+                jobs = atoi(s + 2);
+            else if ((jobs = (int)sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+                jobs = 1;
+            if (jobs < 1)
+                usage();
+            break;
+        case 'O':
+            o_opt = true;
+            break;
+        case 'k':
+            k_opt = true;
+            break;
+        case 'v':
+            v_opt = true;
+            break;
+        case 'B':
+            if (!s[2] && ++i == argc)
+                usage();
+            snprintf(toolDir, sizeof(toolDir), "%s", s[2] ? s + 2 : argv[i]);
+            break;
+        case 'C':
+            if (!s[2] && ++i == argc)
+                usage();
+            cacheDir = s[2] ? s + 2 : argv[i];
+            break;
+        case 's':
+            s_opt = true;
+            break;
+        case 'M':
+            m_opt = true;
+            break;
+        case 'd':
+            if (!s[2] && ++i == argc)
+                usage();
+            objDir = s[2] ? s + 2 : argv[i];
+            break;
+        case 'o':
+            if (!s[2] && ++i == argc)
+                usage();
+            objName = s[2] ? s + 2 : argv[i];
+            break;
+        case 'F':
+            if (!s[2] && ++i == argc)
+                usage();
+            frameFile = s[2] ? s + 2 : argv[i];
+            break;
+        default:
+            usage();
+        }
+    }
+    if (cacheDir && *cacheDir && !frameFile) /* objects depend on the whole program */
+        caching = cacheInit(cacheDir);
+    if (s_opt && !unitCnt) {
+        if (!caching)
+            fatal("no cache directory");
+        cacheStats();
+        return 0;
+    }
+    if (unitCnt == 0 || (objName && unitCnt != 1))
+        usage();
+    findTools(argv[0]);
+
+    for (i = 0; i < unitCnt; i++) {
+        s = (t = strrchr(units[i].src, '/')) ? t + 1 : units[i].src;
+        if (objDir) {
+            units[i].base = xmalloc(strlen(objDir) + strlen(s) + 2);
+            sprintf(units[i].base, "%s/%s", objDir, s);
+        } else
+            units[i].base = xstrdup(s);
+        units[i].inFd = -1;
+        if ((t = strrchr(units[i].base, '.')))
+            *t = '\0';
+        units[i].obj = objName ? objName : withSuffix(units[i].base, ".obj");
+        if (m_opt && (t = strrchr(units[i].src, '.')) && strcmp(t, ".c") == 0)
+            units[i].dep = depName(units[i].obj);
+        if (access(units[i].src, R_OK) < 0)
+            fatal("can't open %s", units[i].src);
+    }
+
+    /* without -j follow make's -j, else run one at a time */
+    if (joinJobserver()) {
+        if (!jobs)
+            jobs = MAXJOBS;
+    } else if (!jobs)
+        jobs = 1;
+    if (jobs > MAXJOBS)
+        jobs = MAXJOBS;
+
+    if (pipe(sigPipe) < 0)
+        fatal("can't create pipe");
+    for (i = 0; i < 2; i++)
+        fcntl(sigPipe[i], F_SETFL, O_NONBLOCK), fcntl(sigPipe[i], F_SETFD, FD_CLOEXEC);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onChild;
+    sa.sa_flags   = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+    sa.sa_handler = onKill;
+    sa.sa_flags   = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+
+    failed = 0;
+    if (frameFile) {
+        if (!(fp = fopen(frameFile, "w")) || fclose(fp) == EOF)
+            fatal("can't create %s", frameFile);
+        graphPass = true;
+        failed    = compileAll();
+        graphPass = false;
+        for (i = 0; i < unitCnt; i++)
+            units[i].state = PENDING;
+    }
+    if (!failed)
+        failed = compileAll();
+    if (caching)
+        cacheEnd(v_opt);
+    if (s_opt)
+        cacheStats();
+    return failed != 0;
+}
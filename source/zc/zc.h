@@ -0,0 +1,33 @@
+#ifndef _ZC_H
+#define _ZC_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;
+    uint8_t buf[64];
+} sha256_t;
+
+/* zc.c */
+extern char *progName;
+void error(char *fmt, ...);
+void fatal(char *fmt, ...);
+void *xmalloc(size_t size);
+char *xstrdup(char *s);
+
+/* cache.c */
+bool cacheInit(char *dir);
+void cacheKeyInit(sha256_t *sp, char **tools, int ntools, char *flags);
+bool cacheGet(uint8_t key[32], char *obj);
+void cachePut(uint8_t key[32], char *obj);
+void cacheEnd(bool verbose);
+void cacheStats(void);
+
+/* sha256.c */
+void sha256Init(sha256_t *sp);
+void sha256Add(sha256_t *sp, const void *data, size_t len);
+void sha256End(sha256_t *sp, uint8_t digest[32]);
+
+#endif